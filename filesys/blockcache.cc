@@ -0,0 +1,249 @@
+// blockcache.cc
+//	Routines for the write-back cache of disk sectors.  See
+//	blockcache.h.
+//
+//	A block is "busy" while the disk reads it in or writes it back.
+//	The cache lock is released for the I/O, and threads wanting a
+//	busy block wait on "ioDone" and then look again, since anything
+//	may have changed in the meantime.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "blockcache.h"
+
+//----------------------------------------------------------------------
+// BlockCache::BlockCache
+// 	Initialize an empty cache, and start the flusher thread.
+//
+//	"disk" -- where the sectors live
+//	"numBlocks" -- how many sectors the cache can hold
+//----------------------------------------------------------------------
+
+BlockCache::BlockCache(SynchDisk *d, int n)
+{
+    int i;
+
+    disk = d;
+    numBlocks = n;
+    data = new char[numBlocks * SectorSize];
+    sectorOf = new int[numBlocks];
+    dirty = new bool[numBlocks];
+    busy = new bool[numBlocks];
+    lastUse = new unsigned int[numBlocks];
+    for (i = 0; i < numBlocks; i++) {
+	sectorOf[i] = -1;
+	dirty[i] = busy[i] = FALSE;
+	lastUse[i] = 0;
+    }
+    blockOf = new int[NumSectors];
+    for (i = 0; i < NumSectors; i++)
+	blockOf[i] = -1;
+    clock = 0;
+    lock = new Lock("block cache");
+    ioDone = new Condition("block cache I/O done");
+    flushWanted = new Semaphore("block cache flush", 0);
+    flushArmed = FALSE;
+
+    Thread *t = new Thread("flusher");
+    t->Fork(Flusher, (void *) this);
+}
+
+//----------------------------------------------------------------------
+// BlockCache::~BlockCache
+// 	De-allocate the cache.  Dirty sectors are lost: call Sync first.
+//----------------------------------------------------------------------
+
+BlockCache::~BlockCache()
+{
+    delete [] data;
+    delete [] sectorOf;
+    delete [] blockOf;
+    delete [] dirty;
+    delete [] busy;
+    delete [] lastUse;
+    delete lock;
+    delete ioDone;
+    delete flushWanted;
+}
+
+//----------------------------------------------------------------------
+// BlockCache::ReadSector
+// 	Copy the contents of "sector" into "into", reading it from disk
+//	only if it is not cached.
+//----------------------------------------------------------------------
+
+void
+BlockCache::ReadSector(int sector, char *into)
+{
+    lock->Acquire();
+    int block = Lookup(sector, TRUE);
+    bcopy(data + block * SectorSize, into, SectorSize);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BlockCache::WriteSector
+// 	Replace the contents of "sector" with "from".  Only the cached
+//	copy changes; make sure the flusher will write it back.
+//----------------------------------------------------------------------
+
+void
+BlockCache::WriteSector(int sector, char *from)
+{
+    lock->Acquire();
+    int block = Lookup(sector, FALSE);
+    bcopy(from, data + block * SectorSize, SectorSize);
+    dirty[block] = TRUE;
+    if (!flushArmed) {
+	flushArmed = TRUE;
+	// not a TimerInt: an idle machine would halt instead of waiting
+	interrupt->Schedule(FlushTick, (int) this, FlushInterval, DiskInt);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BlockCache::Sync
+// 	Write every dirty sector back to disk.  Sectors written while we
+//	wait for the disk may still be dirty when we return.
+//----------------------------------------------------------------------
+
+void
+BlockCache::Sync()
+{
+    lock->Acquire();
+    for (int i = 0; i < numBlocks; i++) {
+	while (busy[i])
+	    ioDone->Wait(lock);
+	if (sectorOf[i] != -1 && dirty[i])
+	    WriteBack(i);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BlockCache::Lookup
+// 	Return the block holding "sector", not busy, making room for it
+//	if it is not cached: the victim is written back first if dirty.
+//	Called, and returns, with the cache lock held.
+//
+//	"fill" -- read the sector in on a miss; FALSE when the caller is
+//		about to overwrite all of it
+//----------------------------------------------------------------------
+
+int
+BlockCache::Lookup(int sector, bool fill)
+{
+    int block;
+
+    ASSERT(sector >= 0 && sector < NumSectors);
+    for (;;) {
+	if ((block = blockOf[sector]) != -1) {
+	    if (busy[block]) {
+		ioDone->Wait(lock);
+		continue;
+	    }
+	    stats->numCacheHits++;
+	    break;
+	}
+	if ((block = Victim()) == -1) {	// everything is busy
+	    ioDone->Wait(lock);
+	    continue;
+	}
+	if (sectorOf[block] != -1 && dirty[block]) {
+	    WriteBack(block);
+	    continue;			// someone may have cached "sector"
+	}				// in the meantime
+	if (sectorOf[block] != -1)
+	    blockOf[sectorOf[block]] = -1;
+	sectorOf[block] = sector;
+	blockOf[sector] = block;
+	stats->numCacheMisses++;
+	if (fill) {
+	    busy[block] = TRUE;
+	    lock->Release();
+	    disk->ReadSector(sector, data + block * SectorSize);
+	    lock->Acquire();
+	    busy[block] = FALSE;
+	    ioDone->Broadcast(lock);
+	}
+	break;
+    }
+    lastUse[block] = ++clock;
+    return block;
+}
+
+//----------------------------------------------------------------------
+// BlockCache::Victim
+// 	Return the least recently used block that is not busy (an unused
+//	block never was), or -1 if all are busy.
+//----------------------------------------------------------------------
+
+int
+BlockCache::Victim()
+{
+    int victim = -1;
+
+    for (int i = 0; i < numBlocks; i++)
+	if (!busy[i] && (victim == -1 || lastUse[i] < lastUse[victim]))
+	    victim = i;
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// BlockCache::WriteBack
+// 	Write dirty block "block" to its sector.  It is marked clean
+//	before the write, so a write meanwhile (after the block stops
+//	being busy) makes it dirty again.  Called, and returns, with the
+//	cache lock held.
+//----------------------------------------------------------------------
+
+void
+BlockCache::WriteBack(int block)
+{
+    busy[block] = TRUE;
+    dirty[block] = FALSE;
+    lock->Release();
+    disk->WriteSector(sectorOf[block], data + block * SectorSize);
+    lock->Acquire();
+    busy[block] = FALSE;
+    stats->numCacheWriteBacks++;
+    ioDone->Broadcast(lock);
+}
+
+//----------------------------------------------------------------------
+// BlockCache::FlushTick
+// 	Interrupt, FlushInterval ticks after a write found the
+//	flusher idle: wake it up.  Interrupt handlers must not wait, so
+//	the writing is left to the flusher thread.
+//----------------------------------------------------------------------
+
+void
+BlockCache::FlushTick(int self)
+{
+    ((BlockCache *) self)->flushWanted->V();
+}
+
+//----------------------------------------------------------------------
+// BlockCache::Flusher
+// 	Body of the flusher thread: each time FlushTick wakes it, write
+//	back everything dirty.  The next write schedules the next tick.
+//----------------------------------------------------------------------
+
+void
+BlockCache::Flusher(int self)
+{
+    BlockCache *cache = (BlockCache *) self;
+
+    for (;;) {
+	cache->flushWanted->P();
+	cache->lock->Acquire();
+	cache->flushArmed = FALSE;
+	cache->lock->Release();
+	cache->Sync();
+    }
+}
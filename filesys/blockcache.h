@@ -0,0 +1,69 @@
+// blockcache.h
+//	Data structures for a write-back cache of disk sectors, in front
+//	of the synchronous disk.
+//
+//	Every file system access to a sector -- file headers, index
+//	blocks, data, the free map and directories -- goes through the
+//	cache, so a sector used again soon costs a copy instead of a seek
+//	and a rotation.  Writes only dirty the cached copy; dirty sectors
+//	reach the disk when they are replaced, when the flusher thread
+//	runs (FlushInterval ticks after the first write since its last
+//	run), or on Sync.  The least recently used sector is replaced.
+//
+//	The swap area does not use the cache: it moves whole pages that
+//	are not read again until they are needed, and its sectors are
+//	never touched by the file system.
+//
+//	The cache has its own lock, which it never holds while waiting
+//	for the disk, so callers may use it while holding their own locks.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include "copyright.h"
+#include "synchdisk.h"
+
+#define DefaultCacheBlocks	64	// sectors the cache holds
+#define FlushInterval		100000	// ticks a written sector may stay
+					// dirty before the flusher runs
+
+class BlockCache {
+  public:
+    BlockCache(SynchDisk *disk, int numBlocks);
+					// Start an empty cache, and its
+					// flusher thread
+    ~BlockCache();			// De-allocate the cache; Sync first!
+
+    void ReadSector(int sector, char *data);
+    void WriteSector(int sector, char *data);
+					// Same as SynchDisk's, but through
+					// the cache
+    void Sync();			// Write every dirty sector back
+
+  private:
+    int Lookup(int sector, bool fill);	// Find or load a cached sector
+    int Victim();			// The block to replace, or -1
+    void WriteBack(int block);		// Write a dirty block to disk
+    static void Flusher(int self);	// Body of the flusher thread
+    static void FlushTick(int self);	// Interrupt waking it up
+
+    SynchDisk *disk;
+    int numBlocks;
+    char *data;				// contents, SectorSize bytes a block
+    int *sectorOf;			// per block, the sector or -1
+    int *blockOf;			// per sector, its block or -1
+    bool *dirty;			// written since read or written back
+    bool *busy;				// disk I/O in progress
+    unsigned int *lastUse;		// for LRU
+    unsigned int clock;
+    Lock *lock;				// protects all of the above
+    Condition *ioDone;			// signalled when I/O finishes
+    Semaphore *flushWanted;		// V'd by FlushTick
+    bool flushArmed;			// a FlushTick is scheduled
+};
+
+#endif // BLOCKCACHE_H
@@ -10,6 +10,9 @@
 //	blocks). The table size is chosen so that the file header
 //	will be just big enough to fit in one disk sector, 
 //
+//	Files can instead be laid out in extents, runs of contiguous
+//	sectors; see filehdr.h.
+//
 //      Unlike in a real system, we do not keep track of file permissions, 
 //	ownership, last modification date, etc., in the file header. 
 //
@@ -27,6 +30,8 @@
 #include "system.h"
 #include "filehdr.h"
 
+bool ExtentFiles = TRUE;		// lay out new files in extents
+
 //----------------------------------------------------------------------
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
@@ -34,6 +39,9 @@
 //	Return FALSE if there are not enough free blocks to accomodate
 //	the new file.
 //
+//	Unless ExtentFiles is off, the file is laid out in extents, and
+//	its sectors are allocated in as few runs as the free map allows.
+//
 //	"freeMap" is the bit map of free disk sectors
 //	"fileSize" is the bit map of free disk sectors
 //----------------------------------------------------------------------
@@ -43,6 +51,21 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize, int type)
 { 
     DEBUG('f', "Allocating file with size %d, type %d\n",
         fileSize, type);
+    if (ExtentFiles) {
+        filetype = type | ExtentLayout;
+        numBytes = numSectors = 0;
+        for (int i = 0; i < NumFirstIdx; i++)
+            FirstIdx[i] = -1;		// no overflow block, no extents
+        if (!GrowExtents(freeMap, divRoundUp(fileSize, SectorSize)))
+            return FALSE;
+        numBytes = fileSize;
+        numSectors = divRoundUp(fileSize, SectorSize);
+        LoadBlockMap();
+        time(&creation);
+        time(&lastaccess);
+        time(&lastwrite);
+        return TRUE;
+    }
     numBytes = fileSize;
     numSectors  = divRoundUp(fileSize, SectorSize);
     filetype = type;
@@ -52,18 +75,20 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize, int type)
     if(numSI > NumFirstIdx)
         return FALSE;
     int tmp[NumSecondIdx];
+    delete [] dataSectors;
+    dataSectors = new int[numSectors];
     for(int i = 0; i < numSI; i++)
     {
         FirstIdx[i] = freeMap->Find();
-        synchDisk->ReadSector(FirstIdx[i], (char*)tmp);
+        blockCache->ReadSector(FirstIdx[i], (char*)tmp);
         for(int j = 0; j < NumSecondIdx; j++)
         {
             if(i*NumSecondIdx+j < numSectors)
-                tmp[j] = freeMap->Find();
+                tmp[j] = dataSectors[i*NumSecondIdx+j] = freeMap->Find();
             else
                 tmp[j] = -1;
         }
-        synchDisk->WriteSector(FirstIdx[i], (char*)tmp);
+        blockCache->WriteSector(FirstIdx[i], (char*)tmp);
     }
     for(int i = numSI; i < NumFirstIdx; i++)
         FirstIdx[i] = -1;
@@ -85,13 +110,20 @@ void
 FileHeader::Deallocate(BitMap *freeMap)
 {
     DEBUG('f', "Deallocating file\n");
+    if (IsExtents()) {
+        ShrinkExtents(freeMap, 0);
+        numBytes = numSectors = 0;
+        delete [] dataSectors;
+        dataSectors = NULL;
+        return;
+    }
     int numSI = divRoundUp(numSectors, NumSecondIdx);
     int tmp[NumSecondIdx];
     for(int i = 0; i < numSI; i++)
     {
         ASSERT(freeMap->Test(FirstIdx[i]));
 //        DEBUG('f', "freeing first index at %d\n", FirstIdx[i]);
-        synchDisk->ReadSector(FirstIdx[i], (char*)tmp);
+        blockCache->ReadSector(FirstIdx[i], (char*)tmp);
         for(int j = 0; j < NumSecondIdx; j++)
         {
             if(i*NumSecondIdx+j < numSectors)
@@ -102,14 +134,26 @@ FileHeader::Deallocate(BitMap *freeMap)
                 tmp[j] = -1;
             }
         }
-//        synchDisk->WriteSector(FirstIdx[i], (char*)tmp);
+//        blockCache->WriteSector(FirstIdx[i], (char*)tmp);
         freeMap->Clear(FirstIdx[i]);
         FirstIdx[i] = -1;
     }
     numBytes = numSectors = 0;
+    delete [] dataSectors;
+    dataSectors = NULL;
     freeMap->Print();
 }
 
+//----------------------------------------------------------------------
+// FileHeader::Reallocate
+// 	Grow or shrink the file to "newSize" bytes, allocating or freeing
+//	data and index blocks.  The block map, if there is one, follows.
+//	Return FALSE if there are not enough free blocks to grow.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"newSize" is the new length of the file, in bytes
+//----------------------------------------------------------------------
+
 bool
 FileHeader::Reallocate(BitMap *freeMap, int newSize)
 {
@@ -119,6 +163,20 @@ FileHeader::Reallocate(BitMap *freeMap, int newSize)
         Deallocate(freeMap);
         return TRUE;
     }
+    else if(IsExtents())
+    {
+        int nnumSectors = divRoundUp(newSize, SectorSize);
+        if(nnumSectors > numSectors &&
+            !GrowExtents(freeMap, nnumSectors - numSectors))
+            return FALSE;//no enough space
+        if(nnumSectors < numSectors)
+            ShrinkExtents(freeMap, nnumSectors);
+        numBytes = newSize;
+        numSectors = nnumSectors;
+        if(dataSectors != NULL)
+            LoadBlockMap();
+        return TRUE;
+    }
     else if(newSize > numBytes)
     {
         int nnumSectors = divRoundUp(newSize, SectorSize);
@@ -132,6 +190,12 @@ FileHeader::Reallocate(BitMap *freeMap, int newSize)
         if(nnumSI > NumFirstIdx)
             return FALSE;//no enough space
         int tmp[NumSecondIdx];
+        int *map = NULL;
+        if(dataSectors != NULL)
+        {
+            map = new int[nnumSectors];
+            bcopy((char*)dataSectors, (char*)map, numSectors * sizeof(int));
+        }
         for(int i = numSectors; i < nnumSectors;)
         {
             int fidx = divRoundDown(i, NumSecondIdx);
@@ -139,18 +203,25 @@ FileHeader::Reallocate(BitMap *freeMap, int newSize)
             {
                 FirstIdx[fidx] = freeMap->Find();
             }
-            synchDisk->ReadSector(FirstIdx[fidx], (char*)tmp);
+            blockCache->ReadSector(FirstIdx[fidx], (char*)tmp);
             for(int j = i-fidx*NumSecondIdx;
                 j < NumSecondIdx; j++, i++)
             {
                 if(fidx*NumSecondIdx+j < nnumSectors)
                 {
                     tmp[j] = freeMap->Find();
+                    if(map != NULL)
+                        map[fidx*NumSecondIdx+j] = tmp[j];
                 }
                 else
                     tmp[j] = -1;
             }
-            synchDisk->WriteSector(FirstIdx[fidx], (char*)tmp);
+            blockCache->WriteSector(FirstIdx[fidx], (char*)tmp);
+        }
+        if(map != NULL)
+        {
+            delete [] dataSectors;
+            dataSectors = map;
         }
         numBytes = newSize;
         numSectors = nnumSectors;
@@ -166,7 +237,7 @@ FileHeader::Reallocate(BitMap *freeMap, int newSize)
         {
             int fidx = divRoundDown(i, NumSecondIdx);
             ASSERT(freeMap->Test(FirstIdx[fidx]));
-            synchDisk->ReadSector(FirstIdx[fidx], (char*)tmp);
+            blockCache->ReadSector(FirstIdx[fidx], (char*)tmp);
             for(int j = i-fidx*NumSecondIdx;
                 j >= 0; j--, i--)
             {
@@ -174,7 +245,7 @@ FileHeader::Reallocate(BitMap *freeMap, int newSize)
                 freeMap->Clear(tmp[j]);
                 tmp[j] = -1;
             }
-            synchDisk->WriteSector(FirstIdx[fidx], (char*)tmp);
+            blockCache->WriteSector(FirstIdx[fidx], (char*)tmp);
             if(i < fidx*NumSecondIdx)
                 FirstIdx[fidx] = -1;
         }
@@ -187,7 +258,8 @@ FileHeader::Reallocate(BitMap *freeMap, int newSize)
 
 //----------------------------------------------------------------------
 // FileHeader::FetchFrom
-// 	Fetch contents of file header from disk. 
+// 	Fetch contents of file header from disk.  Any block map is
+//	dropped; call LoadBlockMap to decode the new one.
 //
 //	"sector" is the disk sector containing the file header
 //----------------------------------------------------------------------
@@ -195,7 +267,12 @@ FileHeader::Reallocate(BitMap *freeMap, int newSize)
 void
 FileHeader::FetchFrom(int sector)
 {
-    synchDisk->ReadSector(sector, (char *)this);
+    char buf[SectorSize];
+
+    blockCache->ReadSector(sector, buf);
+    bcopy(buf, (char *)this, DiskSize());
+    delete [] dataSectors;
+    dataSectors = NULL;
 }
 
 //----------------------------------------------------------------------
@@ -208,7 +285,204 @@ FileHeader::FetchFrom(int sector)
 void
 FileHeader::WriteBack(int sector)
 {
-    synchDisk->WriteSector(sector, (char *)this); 
+    char buf[SectorSize];
+
+    bzero(buf, SectorSize);
+    bcopy((char *)this, buf, DiskSize());
+    blockCache->WriteSector(sector, buf); 
+}
+
+//----------------------------------------------------------------------
+// FileHeader::DiskSize
+// 	Return how many bytes of the header, from its start, are kept on
+//	disk: everything before the in-memory block map, up to a sector.
+//----------------------------------------------------------------------
+
+int
+FileHeader::DiskSize()
+{
+    int size = (char *)&dataSectors - (char *)this;
+
+    return (size < SectorSize) ? size : SectorSize;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::LoadBlockMap
+// 	Decode the index blocks of a header read from disk into its block
+//	map, one index block read each, so that ByteToSector never has to
+//	read one again.
+//----------------------------------------------------------------------
+
+void
+FileHeader::LoadBlockMap()
+{
+    int numSI = divRoundUp(numSectors, NumSecondIdx);
+    int tmp[NumSecondIdx];
+
+    delete [] dataSectors;
+    dataSectors = new int[numSectors];
+    if (IsExtents()) {
+        Extent list[MaxExtents];
+        int n = GetExtents(list), k = 0;
+
+        for (int i = 0; i < n; i++)
+            for (int j = 0; j < list[i].length && k < numSectors; j++)
+                dataSectors[k++] = list[i].start + j;
+        return;
+    }
+    for (int i = 0; i < numSI; i++) {
+        blockCache->ReadSector(FirstIdx[i], (char*)tmp);
+        for (int j = 0; j < (int) NumSecondIdx
+                && i * (int) NumSecondIdx + j < numSectors; j++)
+            dataSectors[i*NumSecondIdx+j] = tmp[j];
+    }
+}
+
+//----------------------------------------------------------------------
+// FileHeader::GetExtents
+// 	Copy the extent list of a file laid out in extents into "list",
+//	which has room for MaxExtents, reading the overflow block if
+//	there is one.  Return the number of extents.
+//----------------------------------------------------------------------
+
+int
+FileHeader::GetExtents(Extent *list)
+{
+    Extent *inHeader = (Extent *) &FirstIdx[1];
+    Extent overflow[NumOvfExtents];
+    int n;
+
+    for (n = 0; n < NumHdrExtents && inHeader[n].length > 0; n++)
+        list[n] = inHeader[n];
+    if (FirstIdx[0] != -1) {
+        blockCache->ReadSector(FirstIdx[0], (char *) overflow);
+        for (int i = 0; i < NumOvfExtents && overflow[i].length > 0; i++)
+            list[n++] = overflow[i];
+    }
+    return n;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::PutExtents
+// 	Store "n" extents from "list" as the extent list of the file.
+//	The first NumHdrExtents go in the header; the overflow block is
+//	allocated for the rest, or freed if it is no longer needed.
+//	Return FALSE, changing nothing, if the extents do not fit.
+//
+//	"freeMap" is the bit map of free disk sectors
+//----------------------------------------------------------------------
+
+bool
+FileHeader::PutExtents(BitMap *freeMap, Extent *list, int n)
+{
+    Extent *inHeader = (Extent *) &FirstIdx[1];
+    Extent overflow[NumOvfExtents];
+    int i;
+
+    if (n > MaxExtents)
+        return FALSE;
+    if (n > NumHdrExtents && FirstIdx[0] == -1
+            && (FirstIdx[0] = freeMap->Find()) == -1)
+        return FALSE;
+    for (i = 0; i < NumHdrExtents; i++) {
+        inHeader[i].start = (i < n) ? list[i].start : -1;
+        inHeader[i].length = (i < n) ? list[i].length : 0;
+    }
+    if (n > NumHdrExtents) {
+        for (i = 0; i < NumOvfExtents; i++) {
+            int k = NumHdrExtents + i;
+            overflow[i].start = (k < n) ? list[k].start : -1;
+            overflow[i].length = (k < n) ? list[k].length : 0;
+        }
+        blockCache->WriteSector(FirstIdx[0], (char *) overflow);
+    } else if (FirstIdx[0] != -1) {
+        freeMap->Clear(FirstIdx[0]);
+        FirstIdx[0] = -1;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::GrowExtents
+// 	Add "more" sectors to the end of a file laid out in extents.  The
+//	last extent is grown in place as far as the sectors after it are
+//	free; the rest comes from the first free run long enough, searched
+//	for from there, or else from the longest runs there are.  Return
+//	FALSE, giving back what was taken, if the disk is full or the
+//	extents would not fit in the header and its overflow block.
+//
+//	"freeMap" is the bit map of free disk sectors
+//----------------------------------------------------------------------
+
+bool
+FileHeader::GrowExtents(BitMap *freeMap, int more)
+{
+    Extent list[MaxExtents], taken[MaxExtents];
+    int n = GetExtents(list), numTaken = 0;
+    int next = (n > 0) ? list[n - 1].start + list[n - 1].length : 0;
+
+    while (more > 0) {
+        int start, got = 0;
+
+        if (n > 0 && next < NumSectors && !freeMap->Test(next)) {
+            start = next;		// grow in place
+            while (got < more && start + got < NumSectors
+                    && !freeMap->Test(start + got))
+                got++;
+        } else if ((start = freeMap->FindRun(more, next, &got)) == -1)
+            break;			// the disk is full
+        if (n > 0 && list[n - 1].start + list[n - 1].length == start)
+            list[n - 1].length += got;
+        else if (n == MaxExtents)
+            break;			// too scattered
+        else {
+            list[n].start = start;
+            list[n++].length = got;
+        }
+        for (int i = 0; i < got; i++)
+            freeMap->Mark(start + i);
+        taken[numTaken].start = start;
+        taken[numTaken++].length = got;
+        DEBUG('f', "Extent grows by %d sectors at %d\n", got, start);
+        more -= got;
+        next = start + got;
+    }
+    if (more == 0 && PutExtents(freeMap, list, n))
+        return TRUE;
+    for (int i = 0; i < numTaken; i++)
+        for (int j = 0; j < taken[i].length; j++)
+            freeMap->Clear(taken[i].start + j);
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ShrinkExtents
+// 	Free every sector of a file laid out in extents but the first
+//	"keep", trimming its extent list to match.
+//
+//	"freeMap" is the bit map of free disk sectors
+//----------------------------------------------------------------------
+
+void
+FileHeader::ShrinkExtents(BitMap *freeMap, int keep)
+{
+    Extent list[MaxExtents];
+    int n = GetExtents(list), m = 0;
+
+    for (int i = 0; i < n; i++) {
+        int kept = (keep < list[i].length) ? keep : list[i].length;
+
+        for (int j = kept; j < list[i].length; j++) {
+            ASSERT(freeMap->Test(list[i].start + j));
+            freeMap->Clear(list[i].start + j);
+        }
+        keep -= kept;
+        list[i].length = kept;
+        if (kept > 0)
+            m = i + 1;
+    }
+    bool stored = PutExtents(freeMap, list, m);	// never needs a sector
+    ASSERT(stored);
 }
 
 //----------------------------------------------------------------------
@@ -218,6 +492,9 @@ FileHeader::WriteBack(int sector)
 //	offset in the file) to a physical address (the sector where the
 //	data at the offset is stored).
 //
+//	With a block map, this is a table lookup; otherwise the index block
+//	covering the offset is read.
+//
 //	"offset" is the location within the file of the byte in question
 //----------------------------------------------------------------------
 
@@ -225,12 +502,43 @@ int
 FileHeader::ByteToSector(int offset)
 {
     int sec = divRoundDown(offset, SectorSize);
+    if (dataSectors != NULL) {
+        ASSERT(sec < numSectors);
+        return dataSectors[sec];
+    }
+    if (IsExtents()) {
+        Extent list[MaxExtents];
+        int n = GetExtents(list);
+
+        for (int i = 0; i < n; sec -= list[i++].length)
+            if (sec < list[i].length)
+                return list[i].start + sec;
+        ASSERT(FALSE);			// past the end of the file
+        return -1;
+    }
     int fidx = sec/NumSecondIdx;
     int tmp[NumSecondIdx];
-    synchDisk->ReadSector(FirstIdx[fidx], (char*)tmp);
+    blockCache->ReadSector(FirstIdx[fidx], (char*)tmp);
     return (tmp[sec % NumSecondIdx]);
 }
 
+//----------------------------------------------------------------------
+// FileHeader::ContiguousStart
+// 	Return the first data sector of a file laid out as a single
+//	extent, so that its data can be read and written as one run of
+//	sectors; -1 for any other file.
+//----------------------------------------------------------------------
+
+int
+FileHeader::ContiguousStart()
+{
+    Extent list[MaxExtents];
+
+    if (!IsExtents() || numSectors == 0 || GetExtents(list) != 1)
+        return -1;
+    return list[0].start;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::FileLength
 // 	Return the number of bytes in the file.
@@ -257,7 +565,7 @@ FileHeader::Print()
     int tmp[NumSecondIdx];
 
     printf("FileHeader contents.  File size: %d, type: %d\n",
-        numBytes, filetype);
+        numBytes, filetype & ~ExtentLayout);
     printf("creation: ");
     struct tm* _t = localtime(&creation);
     strftime(data, SectorSize, "%x %X", _t);
@@ -272,10 +580,28 @@ FileHeader::Print()
     _t = localtime(&lastwrite);
     strftime(data, SectorSize, "%x %X", _t);
     puts(data);
+    if (IsExtents())
+    {
+        Extent list[MaxExtents];
+        int n = GetExtents(list);
+        printf("extents: ");
+        for (i = 0; i < n; i++)
+            printf("%d+%d, ", list[i].start, list[i].length);
+        printf("\nFile contents:\n");
+        for (i = k = 0; i < numSectors; i++)
+        {
+            blockCache->ReadSector(ByteToSector(i * SectorSize), data);
+            for (j = 0; j < SectorSize && k < numBytes; j++, k++)
+                printf("%02x ", (unsigned char)data[j]);
+            printf("end sector %d\n", ByteToSector(i * SectorSize));
+        }
+        delete [] data;
+        return;
+    }
     for (i = 0; i < numSI; i++)
     {
         printf("%d: ", FirstIdx[i]);
-        synchDisk->ReadSector(FirstIdx[i], (char*)tmp);
+        blockCache->ReadSector(FirstIdx[i], (char*)tmp);
         for(j = 0; j < NumSecondIdx; j++)
         {
             if(i * NumSecondIdx + j < numSectors)
@@ -286,7 +612,7 @@ FileHeader::Print()
     printf("File contents:\n");
 /*
     for (i = k = 0; i < numSectors; i++) {
-	synchDisk->ReadSector(dataSectors[i], data);
+	blockCache->ReadSector(dataSectors[i], data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
 	    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
 		printf("%c", data[j]);
@@ -299,12 +625,12 @@ FileHeader::Print()
     int l = 0, m = 0;
     for (i = 0; i < numSI; i++)
     {
-        synchDisk->ReadSector(FirstIdx[i], (char*)tmp);
+        blockCache->ReadSector(FirstIdx[i], (char*)tmp);
         for(j = 0; j < NumSecondIdx; j++)
         {
             if(i * NumSecondIdx + j < numSectors)
             {
-                synchDisk->ReadSector(tmp[j], data);
+                blockCache->ReadSector(tmp[j], data);
                 for(k = 0; k < SectorSize && l < numBytes; k++, l++)
                 {
                     printf("%02x ", (unsigned char)data[k]);
@@ -24,23 +24,59 @@
 //#define MaxFileSize 	(NumDirect * SectorSize)
 #define MaxFileSize (NumFirstIdx * NumSecondIdx * SectorSize)
 
+// A file laid out in extents keeps, in place of the index blocks, the
+// sector of its overflow extent block (or -1) followed by its first
+// extents; the overflow block holds the rest.
+#define NumHdrExtents ((int) (NumFirstIdx - 1) / 2)
+#define NumOvfExtents ((int) (SectorSize / (2 * sizeof(int))))
+#define MaxExtents (NumHdrExtents + NumOvfExtents)
+
+#define ExtentLayout 0x100		// set in "filetype" if the file is
+					// laid out in extents
+
+extern bool ExtentFiles;		// lay out new files in extents?
+
+// A run of data sectors, contiguous on disk.
+
+class Extent {
+  public:
+    int start;				// first sector
+    int length;				// number of sectors; 0 ends the list
+};
+
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
 // The file header is organized as a simple table of pointers to
 // data blocks. 
 //
+// A file is laid out in one of two ways, recorded in its header: the
+// original index blocks, or extents -- runs of contiguous sectors, which
+// let the disk read a file a track at a time.  New files get extents,
+// unless ExtentFiles is off; files on an older disk keep their index
+// blocks.
+//
 // The file header data structure can be stored in memory or on disk.
 // When it is on disk, it is stored in a single sector -- this means
 // that we assume the size of this data structure to be the same
 // as one disk sector.  Without indirect addressing, this
 // limits the maximum file length to just under 4K bytes.
 //
-// There is no constructor; rather the file header can be initialized
-// by allocating blocks for the file (if it is a new file), or by
-// reading it from disk.
+// The constructor does not initialize the header; rather the file header
+// can be initialized by allocating blocks for the file (if it is a new
+// file), or by reading it from disk.
+//
+// In memory, the header can also hold its block map: the data sector
+// numbers of the whole file, decoded from the index blocks.  With it,
+// ByteToSector needs no disk access.  Allocate builds it, LoadBlockMap
+// builds it for a header read from disk (the in-core headers of open
+// files have one), and Reallocate keeps it up to date.  It is not part
+// of the header on disk.
 
 class FileHeader {
   public:
+    FileHeader() { dataSectors = NULL; }
+    ~FileHeader() { delete [] dataSectors; }
+
     bool Allocate(BitMap *bitMap, int fileSize, int type = 0);
                         // Initialize a file header, 
 						//  including allocating space 
@@ -52,6 +88,8 @@ class FileHeader {
     void FetchFrom(int sectorNumber); 	// Initialize file header from disk
     void WriteBack(int sectorNumber); 	// Write modifications to file header
 					//  back to disk
+    void LoadBlockMap();		// Decode the index blocks, so that
+					// ByteToSector is pure memory work
 
     int ByteToSector(int offset);	// Convert a byte offset into the file
 					// to the disk sector containing
@@ -60,6 +98,9 @@ class FileHeader {
     int FileLength();			// Return the length of the file 
 					// in bytes
 
+    int ContiguousStart();		// First data sector, if the data
+					// is one run of sectors; else -1
+
     void Print();			// Print the contents of the file.
 
     int filetype;
@@ -72,6 +113,19 @@ class FileHeader {
 //    int dataSectors[NumDirect];		// Disk sector numbers for each data 
     int FirstIdx[NumFirstIdx];
 					// block in the file
+
+    bool IsExtents() { return (filetype & ExtentLayout) != 0; }
+    int GetExtents(Extent *list);	// Read the extent list
+    bool PutExtents(BitMap *freeMap, Extent *list, int n);
+					// Store it, in the overflow block too
+    bool GrowExtents(BitMap *freeMap, int more);
+					// Add "more" sectors to the file
+    void ShrinkExtents(BitMap *freeMap, int keep);
+					// Free all but the first "keep" ones
+
+    int DiskSize();			// Bytes of the header kept on disk
+    int *dataSectors;			// In memory only: the block map, one
+					// sector per data block, or NULL
 };
 
 #endif // FILEHDR_H
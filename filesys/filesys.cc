@@ -50,6 +50,7 @@
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "system.h"
 //#include "synch.h"
 
 // Sectors containing the file headers for the bitmap of free sectors,
@@ -67,6 +68,9 @@
 //#define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
 #define DirectoryFileSize 128//temprory
 
+int SwapSectors = DefaultSwapSectors;
+int FirstSwapSector = -1;
+
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
 // 	Initialize the file system.  If format = TRUE, the disk has
@@ -89,6 +93,7 @@ FileSystem::FileSystem(bool format)
     }
     locks[FreeMapSector] = new RWLock("free map lock");
     locks[DirectorySector] = new RWLock("dir lock");
+    swapSector = -1;
     if (format) {
         BitMap *freeMap = new BitMap(NumSectors);
         Directory *directory = new Directory(NumDirEntries);
@@ -153,6 +158,68 @@ FileSystem::FileSystem(bool format)
         freeMapFile = new OpenFile(FreeMapSector, locks[FreeMapSector]);
         directoryFile = new OpenFile(DirectorySector, locks[DirectorySector]);
     }
+#ifdef USER_PROGRAM
+    ReserveSwap();
+#endif
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ReserveSwap
+// 	Find the swap file, or make it, and set FirstSwapSector to the
+//	first of its data sectors.  The file is laid out as a single
+//	extent, whatever -fl says, so that its sectors are a contiguous
+//	run; one of another size than SwapSectors (-sw changed since the
+//	disk was last used) is made again.  A disk formatted before the
+//	swap file existed gets one from its free space, so no file on it
+//	is touched.  If there is no free run of SwapSectors sectors,
+//	paging cannot work: say so and stop.
+//----------------------------------------------------------------------
+
+void
+FileSystem::ReserveSwap()
+{
+    Directory *directory = new Directory(NumDirEntries);
+    FileHeader *hdr = new FileHeader;
+    bool extents = ExtentFiles;
+    int sector;
+
+    directory->FetchFrom(directoryFile);
+    sector = directory->Find(SwapFileName);
+    delete directory;
+    if (sector != -1) {
+        hdr->FetchFrom(sector);
+        if (hdr->FileLength() == SwapSectors * SectorSize)
+            FirstSwapSector = hdr->ContiguousStart();
+        if (FirstSwapSector == -1) {
+            DEBUG('f', "Making the swap file again, %d sectors.\n",
+                    SwapSectors);
+            Remove(SwapFileName);
+            sector = -1;
+        }
+    }
+    if (sector == -1) {
+        ExtentFiles = TRUE;
+        if (Create(SwapFileName, SwapSectors * SectorSize)) {
+            directory = new Directory(NumDirEntries);
+            directory->FetchFrom(directoryFile);
+            sector = directory->Find(SwapFileName);
+            delete directory;
+            hdr->FetchFrom(sector);
+            if ((FirstSwapSector = hdr->ContiguousStart()) == -1)
+                Remove(SwapFileName);	// no run long enough
+        }
+        ExtentFiles = extents;
+    }
+    delete hdr;
+    if (FirstSwapSector == -1) {
+        printf("No room on the disk for a swap area of %d contiguous "
+                "sectors; use -sw to ask for fewer, or -f to format "
+                "the disk\n", SwapSectors);
+        Exit(1);
+    }
+    swapSector = sector;
+    DEBUG('f', "Swap area: sectors %d to %d.\n", FirstSwapSector,
+            FirstSwapSector + SwapSectors - 1);
 }
 
 FileSystem::~FileSystem()
@@ -260,7 +327,7 @@ FileSystem::Open(char *name)
     DEBUG('f', "Opening file %s\n", name);
     directory->FetchFrom(directoryFile);
     sector = directory->Find(name); 
-    if (sector >= 0 && getlock(sector)->ref >= 0)
+    if (sector >= 0 && sector != swapSector && getlock(sector)->ref >= 0)
 	   openFile = new OpenFile(sector);	// name was found in directory 
     delete directory;
     return openFile;				// return NULL if not found
@@ -291,9 +358,9 @@ FileSystem::Remove(char *name)
     directory = new Directory(NumDirEntries);
     directory->FetchFrom(directoryFile);
     sector = directory->Find(name);
-    if (sector == -1) {
+    if (sector == -1 || sector == swapSector) {
        delete directory;
-       return FALSE;			 // file not found 
+       return FALSE;			 // file not found, or paging uses it
     }
     RWLock *lock = getlock(sector);
     if(lock->ref > 0)
@@ -314,6 +381,9 @@ FileSystem::Remove(char *name)
 
     freeMap->WriteBack(freeMapFile);		// flush to disk
     directory->WriteBack(directoryFile);        // flush to disk
+#ifdef USER_PROGRAM
+    textCache->ForgetFile(sector);		// drop its cached code
+#endif
     lock->ref = 0;
     delete fileHdr;
     delete directory;
@@ -354,6 +424,7 @@ FileSystem::Print()
     BitMap *freeMap = new BitMap(NumSectors);
     Directory *directory = new Directory(NumDirEntries);
 
+    inodeTable->Sync();			// the headers of open files
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
     bitHdr->Print();
@@ -67,6 +67,18 @@ class FileSystem {
 #else // FILESYS
 #include "rwlock.h"
 #include "disk.h"
+
+// The swap area (see userprog/swap.h) is a file, SwapFileName, whose data
+// sectors are one contiguous run; paging reads and writes them directly.
+// Its size is set with -sw; where it starts is known once the file system
+// has been mounted.
+
+#define SwapFileName		"/.swap"
+#define DefaultSwapSectors	(NumSectors / 8)
+
+extern int SwapSectors;			// size of the swap area
+extern int FirstSwapSector;		// its first sector, or -1
+
 class FileSystem {
   public:
     FileSystem(bool format);		// Initialize the file system.
@@ -96,6 +108,10 @@ class FileSystem {
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
    RWLock *locks[NumSectors];
+
+   int swapSector;			// header of the swap file, or -1
+
+   void ReserveSwap();			// Find, or make, the swap file
 };
 
 #endif // FILESYS
@@ -0,0 +1,129 @@
+// inode.cc
+//	Routines for the in-core inode table.  See inode.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "inode.h"
+
+//----------------------------------------------------------------------
+// InodeTable::InodeTable
+// 	Initialize an empty inode table: no file is open.
+//----------------------------------------------------------------------
+
+InodeTable::InodeTable()
+{
+    for (int i = 0; i < NumSectors; i++)
+	inodes[i] = NULL;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::~InodeTable
+// 	De-allocate the in-core headers.  Changes not yet written back
+//	are lost: call Sync first.
+//----------------------------------------------------------------------
+
+InodeTable::~InodeTable()
+{
+    for (int i = 0; i < NumSectors; i++)
+	delete inodes[i];
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Get
+// 	Return the in-core header of the file whose header is at
+//	"sector", for a new OpenFile on it.  The first opener fetches it
+//	from disk; the others share it.
+//----------------------------------------------------------------------
+
+FileHeader *
+InodeTable::Get(int sector)
+{
+    if (inodes[sector] == NULL) {
+	inodes[sector] = new Inode;
+	inodes[sector]->hdr.FetchFrom(sector);
+	inodes[sector]->hdr.LoadBlockMap();
+	inodes[sector]->ref = 0;
+	inodes[sector]->dirty = FALSE;
+    }
+    inodes[sector]->ref++;
+    return &inodes[sector]->hdr;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Put
+// 	An OpenFile on the file whose header is at "sector" is being
+//	closed: write the header back if it changed, and forget it once
+//	the last OpenFile is gone.
+//----------------------------------------------------------------------
+
+void
+InodeTable::Put(int sector)
+{
+    Inode *inode = inodes[sector];
+
+    ASSERT(inode != NULL && inode->ref > 0);
+    if (inode->dirty) {
+	inode->dirty = FALSE;
+	inode->hdr.WriteBack(sector);
+    }
+    if (--inode->ref == 0) {
+	inodes[sector] = NULL;
+	delete inode;
+    }
+}
+
+//----------------------------------------------------------------------
+// InodeTable::MarkDirty
+// 	Note that the in-core header at "sector" has changed, so that it
+//	gets written back.
+//----------------------------------------------------------------------
+
+void
+InodeTable::MarkDirty(int sector)
+{
+    ASSERT(inodes[sector] != NULL);
+    inodes[sector]->dirty = TRUE;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Sync
+// 	Write back every header that has changed since it was last
+//	written.  They go to the block cache, which the caller syncs too
+//	if they must reach the disk.
+//----------------------------------------------------------------------
+
+void
+InodeTable::Sync()
+{
+    for (int i = 0; i < NumSectors; i++)
+	if (inodes[i] != NULL && inodes[i]->dirty) {
+	    inodes[i]->dirty = FALSE;
+	    inodes[i]->hdr.WriteBack(i);
+	}
+}
+
+//----------------------------------------------------------------------
+// NoteAccess
+// 	A file is being read: update its access time, relatime-style --
+//	only if the last access was no later than the last write, or is
+//	more than AtimeInterval seconds old.  Most reads thus leave the
+//	header clean.
+//
+//	Returns TRUE if the header changed.
+//----------------------------------------------------------------------
+
+bool
+NoteAccess(FileHeader *hdr)
+{
+    time_t now = time(NULL);
+
+    if (hdr->lastaccess > hdr->lastwrite
+	    && now - hdr->lastaccess < AtimeInterval)
+	return FALSE;
+    hdr->lastaccess = now;
+    return TRUE;
+}
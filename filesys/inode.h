@@ -0,0 +1,52 @@
+// inode.h
+//	Data structures for the in-core inode table: the file headers of
+//	the open files, kept in memory while the files are open.
+//
+//	Every OpenFile on the same file shares one in-core copy of its
+//	header, so reading a file or asking its length does not fetch the
+//	header again.  Its block map is decoded when the file is first
+//	opened, so finding the sector of an offset reads no index block.  A changed header is only marked dirty; it is
+//	written back when an OpenFile on it is closed, or on Sync.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef INODE_H
+#define INODE_H
+
+#include "copyright.h"
+#include "filehdr.h"
+
+#define AtimeInterval	(24 * 60 * 60)	// seconds after which a read
+					// updates the access time anyway
+
+class InodeTable {
+  public:
+    InodeTable();			// Initialize an empty table
+    ~InodeTable();			// De-allocate it; Sync first!
+
+    FileHeader *Get(int sector);	// The in-core header of the file
+					// whose header is at "sector",
+					// fetched if it is not open yet
+    void Put(int sector);		// An OpenFile on it is closed
+    void MarkDirty(int sector);		// The in-core header changed
+    void Sync();			// Write back every dirty header
+
+  private:
+    class Inode {
+      public:
+	FileHeader hdr;
+	int ref;			// OpenFiles sharing it
+	bool dirty;			// differs from the copy on disk
+    };
+
+    Inode *inodes[NumSectors];		// per header sector, or NULL if
+					// the file is not open
+};
+
+extern bool NoteAccess(FileHeader *hdr);
+					// Update the access time of a file
+					// being read, if it is due
+
+#endif // INODE_H
@@ -14,6 +14,7 @@
 #include "copyright.h"
 #include "filehdr.h"
 #include "openfile.h"
+#include "inode.h"
 #include "system.h"
 #include "time.h"
 //#include "synch.h"
@@ -24,15 +25,15 @@
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open; every OpenFile on the file
+//	shares the in-core copy kept by inodeTable.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector, RWLock *l)
 { 
-//    hdr = new FileHeader;
-//    hdr->FetchFrom(sector);
+    hdr = inodeTable->Get(sector);
     seekPosition = 0;
     hdrsector = sector;
     if(!l)
@@ -44,12 +45,12 @@ OpenFile::OpenFile(int sector, RWLock *l)
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
 // 	Close a Nachos file, de-allocating any in-memory data structures.
+//	The file header is written back only if it changed.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
 {
-//    hdr->WriteBack(hdrsector);
-//    delete hdr;
+    inodeTable->Put(hdrsector);
     rwlock->ref--;
 }
 
@@ -127,16 +128,14 @@ OpenFile::ReadAt(char *into, int numBytes, int position, bool lock)
 {
     if(lock)
         rwlock->AcquireReader();
-    FileHeader *hdr = new FileHeader;
-    hdr->FetchFrom(hdrsector);
-    time(&hdr->lastaccess);
     int fileLength = hdr->FileLength();
     int i, firstSector, lastSector, numSectors;
     char *buf;
 
     if ((numBytes <= 0) || (position >= fileLength))
     {
-        rwlock->ReleaseReader();
+        if(lock)
+            rwlock->ReleaseReader();
     	return 0; 				// check request
     }
     if ((position + numBytes) > fileLength)		
@@ -153,15 +152,15 @@ OpenFile::ReadAt(char *into, int numBytes, int position, bool lock)
     buf = new char[numSectors * SectorSize];
     for (i = firstSector; i <= lastSector; i++)
     {
-        synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
+        blockCache->ReadSector(hdr->ByteToSector(i * SectorSize), 
 					&buf[(i - firstSector) * SectorSize]);
     }
 
     // copy the part we want
     bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
     delete [] buf;
-    hdr->WriteBack(hdrsector);
-    delete hdr;
+    if (NoteAccess(hdr))
+        inodeTable->MarkDirty(hdrsector);
     if(lock)
         rwlock->ReleaseReader();
     return numBytes;
@@ -171,10 +170,10 @@ OpenFile::ReadAt(char *into, int numBytes, int position, bool lock)
 int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
+#ifdef USER_PROGRAM
+    textCache->ForgetFile(hdrsector);	// in case it is a program
+#endif
     rwlock->AcquireWriter();
-    FileHeader *hdr = new FileHeader;
-    hdr->FetchFrom(hdrsector);
-    time(&hdr->lastaccess);
     int fileLength = hdr->FileLength();
     int i, firstSector, lastSector, numSectors;
     bool firstAligned, lastAligned;
@@ -196,12 +195,13 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
         {
             DEBUG('f', "Resize file successed\n");
         }
-        hdr->WriteBack(hdrsector);
     }
     DEBUG('f', "%s Writing %d bytes at %d, from file of length %d.\n", 	
 			currentThread->getName(),
             numBytes, position, fileLength);
     time(&hdr->lastwrite);
+    hdr->lastaccess = hdr->lastwrite;
+    inodeTable->MarkDirty(hdrsector);
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
@@ -225,16 +225,213 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
 // write modified sectors back
     for (i = firstSector; i <= lastSector; i++)	
     {
-        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
+        blockCache->WriteSector(hdr->ByteToSector(i * SectorSize), 
 					&buf[(i - firstSector) * SectorSize]);
     }
     delete [] buf;
-    hdr->WriteBack(hdrsector);
-    delete hdr;
     rwlock->ReleaseWriter();
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// SpanCursor
+// 	Walks through the pieces of a scatter/gather transfer, one byte
+//	offset at a time.
+//----------------------------------------------------------------------
+
+class SpanCursor {
+  public:
+    SpanCursor(IOSpan *s, int n) { spans = s; num = n; which = 0; offset = 0; }
+
+    // where the next "count" bytes go, if they are contiguous; else NULL
+    char *Contiguous(int count) {
+	return (which < num && spans[which].len - offset >= count)
+		? spans[which].addr + offset : NULL; }
+
+    void Skip(int count);		// move past "count" bytes
+    void Copy(char *data, int count, bool toSpans);
+					// copy "count" bytes between "data"
+					// and the spans, moving past them
+
+  private:
+    IOSpan *spans;
+    int num;				// number of spans
+    int which;				// current span
+    int offset;				// offset within it
+};
+
+void
+SpanCursor::Skip(int count)
+{
+    offset += count;
+    while (which < num && offset >= spans[which].len) {
+	offset -= spans[which].len;
+	which++;
+    }
+}
+
+void
+SpanCursor::Copy(char *data, int count, bool toSpans)
+{
+    while (count > 0) {
+	ASSERT(which < num);
+	int n = spans[which].len - offset;
+
+	if (n > count)
+	    n = count;
+	if (toSpans)
+	    bcopy(data, spans[which].addr + offset, n);
+	else
+	    bcopy(spans[which].addr + offset, data, n);
+	data += n;
+	count -= n;
+	Skip(n);
+    }
+}
+
+//----------------------------------------------------------------------
+// OpenFile::ReadV/WriteV
+// 	Read/write at the implicit position, scattering the data into (or
+//	gathering it from) several pieces of memory.  Used by the Read and
+//	Write system calls to move data straight between the block cache
+//	and the user's frames.
+//----------------------------------------------------------------------
+
+int
+OpenFile::ReadV(IOSpan *spans, int numSpans)
+{
+   int result = ReadAtV(spans, numSpans, seekPosition);
+   seekPosition += result;
+   return result;
+}
+
+int
+OpenFile::WriteV(IOSpan *spans, int numSpans)
+{
+   int result = WriteAtV(spans, numSpans, seekPosition);
+   seekPosition += result;
+   return result;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::ReadAtV/WriteAtV
+// 	Like ReadAt/WriteAt, but the bytes are spread over "numSpans"
+//	pieces of memory.  A whole sector whose bytes all land in one piece
+//	goes directly between the block cache and that memory; only
+//	sectors that are partially transferred, or that straddle two
+//	pieces, go through a one-sector buffer.
+//----------------------------------------------------------------------
+
+int
+OpenFile::ReadAtV(IOSpan *spans, int numSpans, int position)
+{
+    int numBytes = 0, done, i;
+    char buf[SectorSize];
+    SpanCursor cursor(spans, numSpans);
+
+    for (i = 0; i < numSpans; i++)
+	numBytes += spans[i].len;
+
+    rwlock->AcquireReader();
+    int fileLength = hdr->FileLength();
+
+    if ((numBytes <= 0) || (position >= fileLength))
+    {
+        rwlock->ReleaseReader();
+    	return 0; 				// check request
+    }
+    if ((position + numBytes) > fileLength)		
+	   numBytes = fileLength - position;
+    DEBUG('f', "%s Reading %d bytes at %d into %d pieces, file length %d.\n",
+			currentThread->getName(),
+            numBytes, position, numSpans, fileLength);
+
+    for (done = 0; done < numBytes; ) {
+	int inSector = (position + done) % SectorSize;
+	int count = SectorSize - inSector;
+	int sector = hdr->ByteToSector(position + done - inSector);
+	char *direct;
+
+	if (count > numBytes - done)
+	    count = numBytes - done;
+	if (count == SectorSize && (direct = cursor.Contiguous(count)) != NULL) {
+	    blockCache->ReadSector(sector, direct);
+	    cursor.Skip(count);
+	} else {
+	    blockCache->ReadSector(sector, buf);
+	    cursor.Copy(&buf[inSector], count, TRUE);
+	}
+	done += count;
+    }
+    if (NoteAccess(hdr))
+        inodeTable->MarkDirty(hdrsector);
+    rwlock->ReleaseReader();
+    return numBytes;
+}
+
+int
+OpenFile::WriteAtV(IOSpan *spans, int numSpans, int position)
+{
+    int numBytes = 0, done, i;
+    char buf[SectorSize];
+    SpanCursor cursor(spans, numSpans);
+
+#ifdef USER_PROGRAM
+    textCache->ForgetFile(hdrsector);	// in case it is a program
+#endif
+    for (i = 0; i < numSpans; i++)
+	numBytes += spans[i].len;
+
+    rwlock->AcquireWriter();
+    int fileLength = hdr->FileLength();
+
+    if ((numBytes <= 0))
+    {
+        rwlock->ReleaseWriter();
+	   return 0;				// check request
+    }
+    if ((position + numBytes) > fileLength)
+    {
+        if(!fileSystem->Resize(hdr, position + numBytes))
+        {
+            DEBUG('f', "Resize file failed\n");
+	        numBytes = fileLength - position;
+        }
+        else
+        {
+            DEBUG('f', "Resize file successed\n");
+        }
+    }
+    DEBUG('f', "%s Writing %d bytes at %d from %d pieces, file length %d.\n",
+			currentThread->getName(),
+            numBytes, position, numSpans, fileLength);
+    time(&hdr->lastwrite);
+    hdr->lastaccess = hdr->lastwrite;
+    inodeTable->MarkDirty(hdrsector);
+
+    for (done = 0; done < numBytes; ) {
+	int inSector = (position + done) % SectorSize;
+	int count = SectorSize - inSector;
+	int sector = hdr->ByteToSector(position + done - inSector);
+	char *direct;
+
+	if (count > numBytes - done)
+	    count = numBytes - done;
+	if (count == SectorSize && (direct = cursor.Contiguous(count)) != NULL) {
+	    blockCache->WriteSector(sector, direct);
+	    cursor.Skip(count);
+	} else {
+	    if (count < SectorSize)	// keep the rest of the sector
+		blockCache->ReadSector(sector, buf);
+	    cursor.Copy(&buf[inSector], count, FALSE);
+	    blockCache->WriteSector(sector, buf);
+	}
+	done += count;
+    }
+    rwlock->ReleaseWriter();
+    return (numBytes > 0) ? numBytes : 0;
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Length
 // 	Return the number of bytes in the file.
@@ -243,9 +440,5 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
 int
 OpenFile::Length() 
 { 
-    FileHeader *hdr = new FileHeader;
-    hdr->FetchFrom(hdrsector);
-    int len = hdr->FileLength(); 
-    delete hdr;
-    return len;
+    return hdr->FileLength(); 
 }
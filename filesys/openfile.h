@@ -23,6 +23,15 @@
 #include "copyright.h"
 #include "utility.h"
 
+// One piece of a scatter/gather transfer: "len" bytes of kernel
+// memory starting at "addr" -- typically part of a pinned user frame.
+
+class IOSpan {
+  public:
+    char *addr;
+    int len;
+};
+
 #ifdef FILESYS_STUB			// Temporarily implement calls to 
 					// Nachos file system as calls to UNIX!
 					// See definitions listed under #else
@@ -51,6 +60,23 @@ class OpenFile {
 		return numWritten;
 		}
 
+    int ReadV(IOSpan *spans, int numSpans) {
+		int total = 0;
+		for (int i = 0; i < numSpans; i++) {
+		    int numRead = Read(spans[i].addr, spans[i].len);
+		    total += numRead;
+		    if (numRead < spans[i].len)
+			break;
+		}
+		return total;
+		}
+    int WriteV(IOSpan *spans, int numSpans) {
+		int total = 0;
+		for (int i = 0; i < numSpans; i++)
+		    total += Write(spans[i].addr, spans[i].len);
+		return total;
+		}
+
     int Length() { Lseek(file, 0, 2); return Tell(file); }
     
   private:
@@ -82,13 +108,26 @@ class OpenFile {
 					// bypassing the implicit position.
     int WriteAt(char *from, int numBytes, int position);
 
+    int ReadV(IOSpan *spans, int numSpans);
+    int WriteV(IOSpan *spans, int numSpans);
+					// Read/write at the implicit position,
+					// scattering into or gathering from
+					// several pieces of memory
+    int ReadAtV(IOSpan *spans, int numSpans, int position);
+    int WriteAtV(IOSpan *spans, int numSpans, int position);
+
     int Length(); 			// Return the number of bytes in the
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
+
+    int HeaderSector() { return hdrsector; }
+					// Where the file header is; the file
+					// can be opened again from it
     
   private:
-//    FileHeader *hdr;			// Header for this file 
+    FileHeader *hdr;			// Header for this file, shared
+					// through inodeTable
     int seekPosition;			// Current position within the file
     int hdrsector;
     RWLock *rwlock;
@@ -64,6 +64,7 @@ Interrupt::Interrupt()
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
+    UpdateDeadline();
 }
 
 //----------------------------------------------------------------------
@@ -146,6 +147,10 @@ Interrupt::Enable()
 //	Two things can cause OneTick to be called:
 //		interrupts are re-enabled
 //		a user instruction is executed
+//
+//	Until the time cached in nextDue, checking the pending list
+//	would only take its first interrupt off and put it back, so we
+//	skip straight past it.
 //----------------------------------------------------------------------
 void
 Interrupt::OneTick()
@@ -160,6 +165,8 @@ Interrupt::OneTick()
 	stats->totalTicks += UserTick;
 	stats->userTicks += UserTick;
     }
+    if (stats->totalTicks < nextDue && !yieldOnReturn)
+	return;
     DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
 
 // check any pending interrupts are now ready to fire
@@ -236,10 +243,16 @@ Interrupt::Idle()
 //----------------------------------------------------------------------
 // Interrupt::Halt
 // 	Shut down Nachos cleanly, printing out performance statistics.
+//	What the file system still caches is written back first, so that
+//	the statistics count it.
 //----------------------------------------------------------------------
 void
 Interrupt::Halt()
 {
+#ifdef FILESYS
+    inodeTable->Sync();
+    blockCache->Sync();
+#endif
     printf("Machine halting!\n\n");
     stats->Print();
     Cleanup();     // Never returns.
@@ -272,6 +285,7 @@ Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
     ASSERT(fromNow > 0);
 
     pending->SortedInsert(toOccur, when);
+    UpdateDeadline();
 }
 
 //----------------------------------------------------------------------
@@ -308,6 +322,7 @@ Interrupt::CheckIfDue(bool advanceClock)
 	stats->totalTicks = when;
     } else if (when > stats->totalTicks) {	// not time yet, put it back
 	pending->SortedInsert(toOccur, when);
+	UpdateDeadline();
 	return FALSE;
     }
 
@@ -315,8 +330,10 @@ Interrupt::CheckIfDue(bool advanceClock)
     if ((status == IdleMode) && (toOccur->type == TimerInt) 
 				&& pending->IsEmpty()) {
 	 pending->SortedInsert(toOccur, when);
+	 UpdateDeadline();
 	 return FALSE;
     }
+    UpdateDeadline();
 
     DEBUG('i', "Invoking interrupt handler for the %s at time %d\n", 
 			intTypeNames[toOccur->type], toOccur->when);
@@ -335,6 +352,33 @@ Interrupt::CheckIfDue(bool advanceClock)
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Interrupt::UpdateDeadline
+// 	Cache the time the first pending interrupt is due, so OneTick
+//	can tell cheaply whether there is anything to check.
+//
+//	Putting a not-yet-due interrupt back on the list moves it behind
+//	any others due at the same time, so when the first two are tied,
+//	or when 'i' tracing wants to see every check, we set nextDue to
+//	0 and let OneTick go through CheckIfDue on every tick as before.
+//----------------------------------------------------------------------
+
+void
+Interrupt::UpdateDeadline()
+{
+    int when;
+    bool tied;
+
+    if (DebugIsEnabled('i'))
+	nextDue = 0;
+    else if (pending->SortedPeek(&when, &tied) == NULL)
+	nextDue = 0x7fffffff;		// nothing pending at all
+    else if (tied)
+	nextDue = 0;
+    else
+	nextDue = when;
+}
+
 //----------------------------------------------------------------------
 // PrintPending
 // 	Print information about an interrupt that is scheduled to occur.
@@ -112,6 +112,10 @@ class Interrupt {
     
     void OneTick();       		// Advance simulated time
 
+    int NextDue() { return nextDue; }	// Time before which OneTick has
+					// nothing to do but advance the
+					// clock
+
   private:
     IntStatus level;		// are interrupts enabled or disabled?
     List *pending;		// the list of interrupts scheduled
@@ -120,11 +124,15 @@ class Interrupt {
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
     MachineStatus status;	// idle, kernel mode, user mode
+    int nextDue;		// when the first pending interrupt is
+				// due, or 0 if every tick must check
 
     // these functions are internal to the interrupt simulation code
 
     bool CheckIfDue(bool advanceClock); // Check if an interrupt is supposed
 					// to occur now
+    void UpdateDeadline();		// Recompute nextDue after "pending"
+					// has changed
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
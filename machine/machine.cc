@@ -11,6 +11,16 @@
 #include "machine.h"
 #include "system.h"
 
+// The memory geometry of the simulated machine; see machine.h.
+int PageSize = DefaultPageSize;
+int PageShift = 7;
+int NumPhysPages = DefaultNumPhysPages;
+int TLBSize = DefaultTLBSize;
+int TLB2Size = 0;
+int TLB2Ways = DefaultTLB2Ways;
+TLBReplace TLB2Replace = TLBReplaceLRU;
+bool HardwareWalk = FALSE;
+
 // Textual names of the exceptions that can be generated by user program
 // execution, for debugging.
 static char* exceptionNames[] = { "no exception", "syscall", 
@@ -50,31 +60,62 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"eng" -- the engine Run uses to execute user instructions
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, ExecEngine eng)
 {
     int i;
 
+    ASSERT((1 << PageShift) == PageSize && PageSize % SectorSize == 0);
+    ASSERT(NumPhysPages > 0 && TLBSize > 0);
     for (i = 0; i < NumTotalRegs; i++)
         registers[i] = 0;
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
-    InvPageTable = new TranslationEntry[NumPhysPages];
-    for(i = 0; i < NumPhysPages; i++)
-    {
-        InvPageTable[i].valid = FALSE;
-        InvPageTable[i].tomb = FALSE;
-        InvPageTable[i].t = stats->totalTicks;
+    pageHash = new HashedPageTable(NumPhysPages);
+    InvPageTable = pageHash->entries;
+    decodeCache = new Instruction[MemorySize / 4];
+    decodeValid = new char[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++)
+        decodeValid[i] = FALSE;
+    frameDecoded = new bool[NumPhysPages];
+    for (i = 0; i < NumPhysPages; i++)
+        frameDecoded[i] = FALSE;
+    blockOps = new BlockOp[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++) {
+        blockOps[i].handler = NULL;
+        blockOps[i].length = 0;
+        blockOps[i].count = 0;
+        blockOps[i].trace = NULL;
+    }
+    pinCount = new int[NumPhysPages];
+    frameRefs = new int[NumPhysPages];
+    for (i = 0; i < NumPhysPages; i++)
+        pinCount[i] = frameRefs[i] = 0;
+    engine = eng;
+    translationEpoch = 1;		// so the zeroed soft TLB starts out stale
+    frameEpoch = 0;
+    for (i = 0; i < SoftTLBSize; i++) {
+        softTlb[i].epoch = 0;
+        softTlb[i].entry = NULL;
     }
+    lastEntry = NULL;
 #ifdef USE_TLB
     tlb = new TranslationEntry*[TLBSize];
-    for (i = 0; i < TLBSize; i++)
+    tlbSwitch = new int[TLBSize];
+    tlb2 = TLB2Size > 0 ? new SetAssocTLB(TLB2Size, TLB2Ways, TLB2Replace)
+			: NULL;
+    for (i = 0; i < TLBSize; i++) {
 	   tlb[i] = NULL;
+	   tlbSwitch[i] = 0;
+    }
 //    pageTable = NULL;
 #else	// use linear page table
     tlb = NULL;
+    tlbSwitch = NULL;
+    tlb2 = NULL;
 //    pageTable = NULL;
 #endif
     fd_table = new FDEntry[NumFD];
@@ -91,9 +132,20 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
-    delete [] InvPageTable;
-    if (tlb != NULL)
+    delete pageHash;
+    delete [] decodeCache;
+    delete [] decodeValid;
+    delete [] frameDecoded;
+    for (int i = 0; i < MemorySize / 4; i++)
+        delete blockOps[i].trace;
+    delete [] blockOps;
+    delete [] pinCount;
+    delete [] frameRefs;
+    if (tlb != NULL) {
         delete [] tlb;
+        delete [] tlbSwitch;
+        delete tlb2;
+    }
     delete[] fd_table;
 }
 
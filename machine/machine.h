@@ -29,13 +29,30 @@
 
 // Definitions related to the size, and format of user memory
 
-#define PageSize 	SectorSize 	// set the page size equal to
-					// the disk sector size, for
-					// simplicity
-
-#define NumPhysPages    32
+// The size of physical memory, of a page and of the TLB are chosen when
+// Nachos starts (see Initialize in system.cc), before the Machine is
+// created; they must not change afterwards.  A page is a power of 2 and
+// a whole number of disk sectors, so paging moves whole sectors.
+
+#define DefaultPageSize	SectorSize	// by default one page per sector
+#define DefaultNumPhysPages 32
+#define DefaultTLBSize	4		// if there is a TLB, make it small
+#define DefaultTLB2Ways	4		// L2 TLB associativity; by default
+					// there is no L2 TLB
+
+extern int PageSize;
+extern int PageShift;			// log2(PageSize)
+extern int NumPhysPages;
+extern int TLBSize;
+extern int TLB2Size;			// L2 TLB entries, 0 if none
+extern int TLB2Ways;
+extern TLBReplace TLB2Replace;
+extern bool HardwareWalk;		// TLB misses on resident pages are
+					// refilled from the page table by the
+					// hardware, not the kernel
 #define MemorySize 	(NumPhysPages * PageSize)
-#define TLBSize		4		// if there is a TLB, make it small
+#define SoftTLBSize	64		// entries in the simulator's own
+					// translation cache (power of 2)
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -74,6 +91,13 @@ enum ExceptionType { NoException,           // Everything ok!
 
 #define NumFD 16384
 
+// How Machine::Run executes user instructions: one at a time through
+// the decoding interpreter, a basic block at a time through per-opcode
+// handler routines, or as the block engine but with hot blocks
+// translated into traces with their operands resolved in advance.
+
+enum ExecEngine { InterpEngine, BlockEngine, TraceEngine };
+
 // The following class defines an instruction, represented in both
 // 	undecoded binary form
 //      decoded to identify
@@ -94,6 +118,70 @@ class Instruction {
                      // Immediates are sign-extended.
 };
 
+// An instruction prepared for the basic-block engine.  "handler"
+// carries out the instruction; if a basic block has been built
+// starting at this word, "length" is the number of instructions in
+// it (including the delay slot of the branch that ends it), else 0.
+
+class Machine;
+class Trace;
+typedef bool (*OpHandler)(Machine *m, Instruction *instr);
+
+class BlockOp {
+  public:
+    OpHandler handler;
+    int length;
+    int count;		// times the block has been entered, until hot
+    Trace *trace;	// translation of the block, once it is hot
+};
+
+// One instruction of a translated block: the routine that runs it and
+// its operands -- pointers straight to the registers it uses, and the
+// immediate value already extended, shifted or turned into an absolute
+// branch target.  Instructions without a routine of their own go back
+// to the block engine handler "fallback".
+
+class TraceOp;
+typedef bool (*TraceHandler)(Machine *m, TraceOp *op);
+
+class TraceOp {
+  public:
+    TraceHandler run;
+    int *s, *t, *d;	// source, second source and destination registers
+    int imm;
+    OpHandler fallback;
+    Instruction *instr;
+};
+
+// A translated basic block.  Branch targets depend on where the block
+// sits in the address space, so a trace only runs at "vaddr".
+
+class Trace {
+  public:
+    Trace(int addr, int len) { vaddr = addr; length = len;
+				ops = new TraceOp[len]; }
+    ~Trace() { delete [] ops; }
+
+    int vaddr;
+    int length;
+    TraceOp *ops;
+};
+
+// An entry of the simulator's own cache of recent translations, kept
+// on the host side so that most memory references skip the page table
+// or TLB lookup.  It is only good while "epoch" equals the machine's
+// translationEpoch, which changes whenever the kernel edits the page
+// table or the TLB, or switches address spaces.
+
+class SoftTLBEntry {
+  public:
+    unsigned int vpn;
+    unsigned int epoch;
+    TranslationEntry *entry;	// the entry Translate found for "vpn"
+    char *frame;		// where the page lives in mainMemory
+    bool writable;		// FALSE if "entry" is read-only
+};
+
 class FDEntry
 {
 public:
@@ -118,7 +206,8 @@ public:
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
+    Machine(bool debug, ExecEngine eng = InterpEngine);
+				// Initialize the simulation of the hardware
 				// for running user programs
     ~Machine();			// De-allocate the data structures
 
@@ -135,6 +224,29 @@ class Machine {
 
     void OneInstruction(Instruction *instr); 	
     				// Run one instruction of a user program.
+    bool Execute(Instruction *instr);
+				// Execute an already decoded instruction;
+				// FALSE if it trapped to the kernel
+    void RunBlock();		// Run the basic block starting at the PC
+    void BuildBlock(int word);	// Find the extent of the basic block that
+				// starts at word "word" of mainMemory
+    void TranslateBlock(int word, int vaddr);
+				// Turn a hot basic block into a Trace
+    Instruction *FetchDecoded(int physAddr);
+				// Return the pre-decoded instruction stored
+				// at "physAddr", decoding it on first use
+    void InvalidateFrame(int frame);
+				// Discard pre-decoded instructions of a
+				// physical page whose contents changed
+    void InvalidateTranslations() { translationEpoch++; }
+				// Note that the TLB, the page table, or the
+				// current address space has changed
+    void FlushTLBEntry(TranslationEntry *entry);
+				// Drop "entry" from the TLBs, as its page
+				// leaves memory
+    int TLBVictim();		// The TLB slot to refill next
+    void FillTLB(int slot, TranslationEntry *entry);
+				// Load "entry" into that slot
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
     
@@ -146,6 +258,9 @@ class Machine {
     				// Read or write 1, 2, or 4 bytes of virtual 
 				// memory (at addr).  Return FALSE if a 
 				// correct translation couldn't be found.
+    char *UserBytes(int addr, int len, bool writing, int *count);
+				// Fault in the page at "addr" and return
+				// where its bytes are in mainMemory
     
     ExceptionType Translate(int virtAddr, int* physAddr, int size,bool writing);
     				// Translate an address, and check for 
@@ -153,6 +268,9 @@ class Machine {
 				// the translation entry appropriately,
     				// and return an exception code if the 
 				// translation couldn't be completed.
+    char *SoftTranslate(int virtAddr, int size, bool writing);
+				// Translate through the soft TLB only;
+				// NULL if Translate must be called
 
     void RaiseException(ExceptionType which, int badVAddr);
 				// Trap to the Nachos kernel, because of a
@@ -172,6 +290,22 @@ class Machine {
 				// code and data, while executing
     int registers[NumTotalRegs]; // CPU registers, for executing user programs
 
+    Instruction *decodeCache;	// pre-decoded instruction for every word
+				// of mainMemory, valid if decodeValid is set
+    char *decodeValid;
+    bool *frameDecoded;		// TRUE if some word of the frame is cached
+    BlockOp *blockOps;		// handler and block length for every word
+    ExecEngine engine;		// how Run executes user instructions
+    unsigned int translationEpoch; // bumped whenever a cached translation
+				// may have become stale
+    unsigned int frameEpoch;	// bumped whenever a decoded frame changes
+    SoftTLBEntry softTlb[SoftTLBSize];
+    int *pinCount;		// per frame; a pinned frame is the target
+				// of kernel I/O and must not be replaced
+    int *frameRefs;		// per frame, the page table entries mapping
+				// it; more than one after a fork
+    TranslationEntry *lastEntry; // entry used by the last Translate
+
 
 // NOTE: the hardware translation of virtual addresses in the user program
 // to physical addresses (relative to the beginning of "mainMemory")
@@ -193,19 +327,18 @@ class Machine {
 
     TranslationEntry **tlb;		// this pointer should be considered 
 					// "read-only" to Nachos kernel code
+    int *tlbSwitch;			// per TLB slot, the context switch
+					// count when it was loaded or last
+					// hit; entries are tagged with their
+					// tid, so they outlive switches
+    SetAssocTLB *tlb2;			// the L2 TLB, or NULL
     unsigned int pageTableSize;
 //    TranslationEntry *pageTable;
-    TranslationEntry *InvPageTable;
-    unsigned int addrhash(unsigned int vpn)
-    {
-        return (vpn * 0x9E3779B9) % NumPhysPages;
-    }
-    unsigned int rehash(unsigned int tid)
-    {
-        return (tid*13)%7;
-    }
+    HashedPageTable *pageHash;	// the inverted page table
+    TranslationEntry *InvPageTable;	// its entries
     unsigned int getnew(unsigned int, int);
     unsigned int find(unsigned int, int);
+    void remove(unsigned int);
 
     FDEntry *fd_table;
 
@@ -18,6 +18,23 @@
 
 static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 
+//----------------------------------------------------------------------
+// UserTickDone
+// 	Account for one user instruction.  Until the next pending
+//	interrupt is due, all OneTick would do is advance the clock, so
+//	we do just that here and keep running instructions back to back.
+//----------------------------------------------------------------------
+
+static inline void
+UserTickDone()
+{
+    if (stats->totalTicks + UserTick < interrupt->NextDue()) {
+	stats->totalTicks += UserTick;
+	stats->userTicks += UserTick;
+    } else
+	interrupt->OneTick();
+}
+
 //----------------------------------------------------------------------
 // Machine::Run
 // 	Simulate the execution of a user-level program on Nachos.
@@ -25,6 +42,10 @@ static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 //
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
+//
+//	With the block or trace engine, whole blocks are run at a time, but
+//	we still step one instruction at a time while the debugger or
+//	instruction tracing is active.
 //----------------------------------------------------------------------
 
 void
@@ -37,8 +58,12 @@ Machine::Run()
 	       currentThread->getName(), stats->totalTicks);
     interrupt->setStatus(UserMode);
     for (;;) {
+	if (engine != InterpEngine && !singleStep && !DebugIsEnabled('m')) {
+	    RunBlock();
+	    continue;
+	}
         OneInstruction(instr);
-	interrupt->OneTick();
+	UserTickDone();
 	if (singleStep && (runUntilTime <= stats->totalTicks))
 	  Debugger();
     }
@@ -93,17 +118,37 @@ TypeToReg(RegType reg, Instruction *instr)
 void
 Machine::OneInstruction(Instruction *instr)
 {
-    int raw;
+    int physAddr;
+    ExceptionType exception;
+
+    // Fetch instruction, reusing the decoded form if this word of
+    // physical memory has been decoded before
+    exception = Translate(registers[PCReg], &physAddr, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, registers[PCReg]);
+	return;			// exception occurred
+    }
+    *instr = *FetchDecoded(physAddr);
+    Execute(instr);
+}
+
+//----------------------------------------------------------------------
+// Machine::Execute
+// 	Carry out one instruction that has already been fetched and
+//	decoded, then apply any pending delayed load and advance the PCs.
+//	Returns FALSE if the instruction trapped to the kernel, in which
+//	case the PCs are left for the exception handler to deal with.
+//
+//	"instr" -- the decoded instruction at registers[PCReg]
+//----------------------------------------------------------------------
+
+bool
+Machine::Execute(Instruction *instr)
+{
     int nextLoadReg = 0; 	
     int nextLoadValue = 0; 	// record delayed load operation, to apply
 				// in the future
 
-    // Fetch instruction 
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
-	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
-
     if (DebugIsEnabled('m')) {
        struct OpString *str = &opStrings[instr->opCode];
 
@@ -127,7 +172,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = sum;
 	break;
@@ -137,7 +182,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
 	    ((instr->extra ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rt] = sum;
 	break;
@@ -232,7 +277,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_LBU:
 	tmp = registers[instr->rs] + instr->extra;
 	if (!machine->ReadMem(tmp, 1, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x80) && (instr->opCode == OP_LB))
 	    value |= 0xffffff00;
@@ -247,10 +292,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x1) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!machine->ReadMem(tmp, 2, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x8000) && (instr->opCode == OP_LH))
 	    value |= 0xffff0000;
@@ -269,10 +314,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x3) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	nextLoadReg = instr->rt;
 	nextLoadValue = value;
 	break;
@@ -286,7 +331,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
 	else
@@ -317,7 +362,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
 	else
@@ -373,7 +418,7 @@ Machine::OneInstruction(Instruction *instr)
 	break;
 	
       case OP_OR:
-	registers[instr->rd] = registers[instr->rs] | registers[instr->rs];
+	registers[instr->rd] = registers[instr->rs] | registers[instr->rt];
 	break;
 	
       case OP_ORI:
@@ -383,13 +428,13 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SB:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SH:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SLL:
@@ -459,7 +504,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = diff;
 	break;
@@ -471,7 +516,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SW:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SWL:	  
@@ -482,7 +527,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = registers[instr->rt];
@@ -501,7 +546,7 @@ Machine::OneInstruction(Instruction *instr)
 	    break;
 	}
 	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	    return FALSE;
 	break;
     	
       case OP_SWR:	  
@@ -512,7 +557,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = (value & 0xffffff) | (registers[instr->rt] << 24);
@@ -528,12 +573,12 @@ Machine::OneInstruction(Instruction *instr)
 	    break;
 	}
 	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	    return FALSE;
 	break;
     	
       case OP_SYSCALL:
 	RaiseException(SyscallException, 0);
-	return; 
+	return FALSE; 
 	
       case OP_XOR:
 	registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
@@ -546,7 +591,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_RES:
       case OP_UNIMP:
 	RaiseException(IllegalInstrException, 0);
-	return;
+	return FALSE;
 	
       default:
 	ASSERT(FALSE);
@@ -562,6 +607,7 @@ Machine::OneInstruction(Instruction *instr)
 						// are jumping into lala-land
     registers[PCReg] = registers[NextPCReg];
     registers[NextPCReg] = pcAfter;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -625,6 +671,946 @@ Instruction::Decode()
     }
 }
 
+//----------------------------------------------------------------------
+// Machine::FetchDecoded
+// 	Return the decoded instruction stored at a physical address.
+//	Decoding is done once per word; the result stays cached until
+//	the frame holding it is written or given to another page.
+//
+//	"physAddr" -- word-aligned physical address of the instruction
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::FetchDecoded(int physAddr)
+{
+    int word = physAddr / 4;
+    Instruction *instr = &decodeCache[word];
+
+    if (!decodeValid[word]) {
+	instr->value = WordToHost(*(unsigned int *) &mainMemory[physAddr]);
+	instr->Decode();
+	decodeValid[word] = TRUE;
+	frameDecoded[physAddr / PageSize] = TRUE;
+    }
+    return instr;
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateFrame
+// 	Forget every pre-decoded instruction of a physical page.  Must be
+//	called whenever the contents of the frame change: user stores,
+//	kernel copies into user memory, and page-in by the pager.
+//
+//	"frame" -- the physical page number
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateFrame(int frame)
+{
+    if (!frameDecoded[frame])
+	return;
+    memset(&decodeValid[frame * (PageSize / 4)], FALSE, PageSize / 4);
+    for (int i = frame * (PageSize / 4); i < (frame + 1) * (PageSize / 4); i++) {
+	blockOps[i].length = 0;
+	blockOps[i].count = 0;
+	delete blockOps[i].trace;
+	blockOps[i].trace = NULL;
+    }
+    frameDecoded[frame] = FALSE;
+    frameEpoch++;		// a block may be running in this frame
+}
+
+//----------------------------------------------------------------------
+// Basic-block engine
+//
+//	Every decoded instruction carries a pointer to a routine that
+//	executes it, so a basic block is run by calling through those
+//	pointers in turn instead of going through the big switch in
+//	Execute.  The routines below cover the common instructions; the
+//	rest (partial-word loads and stores, system calls, illegal
+//	instructions) are handed to Execute.
+//
+//	Each routine has exactly the effect Execute would have: on
+//	success it applies the delayed load, advances the PCs and returns
+//	TRUE; if the instruction traps it returns FALSE.
+//----------------------------------------------------------------------
+
+#define REG(r)		(m->registers[instr->r])
+#define NEXTPC		(m->registers[NextPCReg] + 4)
+#define TARGET		(m->registers[NextPCReg] + IndexToAddr(instr->extra))
+
+static inline bool
+Retire(Machine *m, int pcAfter, int loadReg, int loadValue)
+{
+    m->DelayedLoad(loadReg, loadValue);
+    m->registers[PrevPCReg] = m->registers[PCReg];
+    m->registers[PCReg] = m->registers[NextPCReg];
+    m->registers[NextPCReg] = pcAfter;
+    return TRUE;
+}
+
+static bool
+OpGeneric(Machine *m, Instruction *instr)
+{
+    return m->Execute(instr);
+}
+
+static bool
+OpAdd(Machine *m, Instruction *instr)
+{
+    int sum = REG(rs) + REG(rt);
+
+    if (!((REG(rs) ^ REG(rt)) & SIGN_BIT) && ((REG(rs) ^ sum) & SIGN_BIT)) {
+	m->RaiseException(OverflowException, 0);
+	return FALSE;
+    }
+    REG(rd) = sum;
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpAddi(Machine *m, Instruction *instr)
+{
+    int sum = REG(rs) + instr->extra;
+
+    if (!((REG(rs) ^ instr->extra) & SIGN_BIT) &&
+	((instr->extra ^ sum) & SIGN_BIT)) {
+	m->RaiseException(OverflowException, 0);
+	return FALSE;
+    }
+    REG(rt) = sum;
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpSub(Machine *m, Instruction *instr)
+{
+    int diff = REG(rs) - REG(rt);
+
+    if (((REG(rs) ^ REG(rt)) & SIGN_BIT) && ((REG(rs) ^ diff) & SIGN_BIT)) {
+	m->RaiseException(OverflowException, 0);
+	return FALSE;
+    }
+    REG(rd) = diff;
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpAddiu(Machine *m, Instruction *instr)
+{
+    REG(rt) = REG(rs) + instr->extra;
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpAddu(Machine *m, Instruction *instr)
+{
+    REG(rd) = REG(rs) + REG(rt);
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpSubu(Machine *m, Instruction *instr)
+{
+    REG(rd) = REG(rs) - REG(rt);
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpAnd(Machine *m, Instruction *instr)
+{
+    REG(rd) = REG(rs) & REG(rt);
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpAndi(Machine *m, Instruction *instr)
+{
+    REG(rt) = REG(rs) & (instr->extra & 0xffff);
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpOr(Machine *m, Instruction *instr)
+{
+    REG(rd) = REG(rs) | REG(rt);
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpOri(Machine *m, Instruction *instr)
+{
+    REG(rt) = REG(rs) | (instr->extra & 0xffff);
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpXor(Machine *m, Instruction *instr)
+{
+    REG(rd) = REG(rs) ^ REG(rt);
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpXori(Machine *m, Instruction *instr)
+{
+    REG(rt) = REG(rs) ^ (instr->extra & 0xffff);
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpNor(Machine *m, Instruction *instr)
+{
+    REG(rd) = ~(REG(rs) | REG(rt));
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpLui(Machine *m, Instruction *instr)
+{
+    REG(rt) = instr->extra << 16;
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpSlt(Machine *m, Instruction *instr)
+{
+    REG(rd) = (REG(rs) < REG(rt)) ? 1 : 0;
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpSlti(Machine *m, Instruction *instr)
+{
+    REG(rt) = (REG(rs) < instr->extra) ? 1 : 0;
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpSltiu(Machine *m, Instruction *instr)
+{
+    REG(rt) = ((unsigned int) REG(rs) < (unsigned int) instr->extra) ? 1 : 0;
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpSltu(Machine *m, Instruction *instr)
+{
+    REG(rd) = ((unsigned int) REG(rs) < (unsigned int) REG(rt)) ? 1 : 0;
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpSll(Machine *m, Instruction *instr)
+{
+    REG(rd) = REG(rt) << instr->extra;
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpSllv(Machine *m, Instruction *instr)
+{
+    REG(rd) = REG(rt) << (REG(rs) & 0x1f);
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpSra(Machine *m, Instruction *instr)
+{
+    REG(rd) = REG(rt) >> instr->extra;
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpSrav(Machine *m, Instruction *instr)
+{
+    REG(rd) = REG(rt) >> (REG(rs) & 0x1f);
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+// SRL and SRLV shift a signed value, exactly as Execute does
+
+static bool
+OpSrl(Machine *m, Instruction *instr)
+{
+    REG(rd) = REG(rt) >> instr->extra;
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpSrlv(Machine *m, Instruction *instr)
+{
+    REG(rd) = REG(rt) >> (REG(rs) & 0x1f);
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpMfhi(Machine *m, Instruction *instr)
+{
+    REG(rd) = m->registers[HiReg];
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpMflo(Machine *m, Instruction *instr)
+{
+    REG(rd) = m->registers[LoReg];
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpMthi(Machine *m, Instruction *instr)
+{
+    m->registers[HiReg] = REG(rs);
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpMtlo(Machine *m, Instruction *instr)
+{
+    m->registers[LoReg] = REG(rs);
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpMult(Machine *m, Instruction *instr)
+{
+    Mult(REG(rs), REG(rt), TRUE, &m->registers[HiReg], &m->registers[LoReg]);
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpMultu(Machine *m, Instruction *instr)
+{
+    Mult(REG(rs), REG(rt), FALSE, &m->registers[HiReg], &m->registers[LoReg]);
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpDiv(Machine *m, Instruction *instr)
+{
+    if (REG(rt) == 0) {
+	m->registers[LoReg] = 0;
+	m->registers[HiReg] = 0;
+    } else {
+	m->registers[LoReg] = REG(rs) / REG(rt);
+	m->registers[HiReg] = REG(rs) % REG(rt);
+    }
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpDivu(Machine *m, Instruction *instr)
+{
+    unsigned int rs = (unsigned int) REG(rs);
+    unsigned int rt = (unsigned int) REG(rt);
+
+    if (rt == 0) {
+	m->registers[LoReg] = 0;
+	m->registers[HiReg] = 0;
+    } else {
+	m->registers[LoReg] = (int) (rs / rt);
+	m->registers[HiReg] = (int) (rs % rt);
+    }
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpBeq(Machine *m, Instruction *instr)
+{
+    return Retire(m, (REG(rs) == REG(rt)) ? TARGET : NEXTPC, 0, 0);
+}
+
+static bool
+OpBne(Machine *m, Instruction *instr)
+{
+    return Retire(m, (REG(rs) != REG(rt)) ? TARGET : NEXTPC, 0, 0);
+}
+
+static bool
+OpBgez(Machine *m, Instruction *instr)
+{
+    return Retire(m, !(REG(rs) & SIGN_BIT) ? TARGET : NEXTPC, 0, 0);
+}
+
+static bool
+OpBgezal(Machine *m, Instruction *instr)
+{
+    m->registers[R31] = NEXTPC;
+    return OpBgez(m, instr);
+}
+
+static bool
+OpBltz(Machine *m, Instruction *instr)
+{
+    return Retire(m, (REG(rs) & SIGN_BIT) ? TARGET : NEXTPC, 0, 0);
+}
+
+static bool
+OpBltzal(Machine *m, Instruction *instr)
+{
+    m->registers[R31] = NEXTPC;
+    return OpBltz(m, instr);
+}
+
+static bool
+OpBgtz(Machine *m, Instruction *instr)
+{
+    return Retire(m, (REG(rs) > 0) ? TARGET : NEXTPC, 0, 0);
+}
+
+static bool
+OpBlez(Machine *m, Instruction *instr)
+{
+    return Retire(m, (REG(rs) <= 0) ? TARGET : NEXTPC, 0, 0);
+}
+
+static bool
+OpJ(Machine *m, Instruction *instr)
+{
+    return Retire(m, (NEXTPC & 0xf0000000) | IndexToAddr(instr->extra), 0, 0);
+}
+
+static bool
+OpJal(Machine *m, Instruction *instr)
+{
+    m->registers[R31] = NEXTPC;
+    return OpJ(m, instr);
+}
+
+static bool
+OpJr(Machine *m, Instruction *instr)
+{
+    return Retire(m, REG(rs), 0, 0);
+}
+
+static bool
+OpJalr(Machine *m, Instruction *instr)
+{
+    REG(rd) = NEXTPC;
+    return Retire(m, REG(rs), 0, 0);
+}
+
+static bool
+OpLoad(Machine *m, Instruction *instr, int size, bool isSigned)
+{
+    int addr = REG(rs) + instr->extra;
+    int value;
+
+    if (((size == 2) && (addr & 0x1)) || ((size == 4) && (addr & 0x3))) {
+	m->RaiseException(AddressErrorException, addr);
+	return FALSE;
+    }
+    if (!m->ReadMem(addr, size, &value))
+	return FALSE;
+    if (size < 4) {
+	int mask = (size == 1) ? 0xff : 0xffff;
+
+	if (isSigned && (value & ((mask + 1) >> 1)))
+	    value |= ~mask;
+	else
+	    value &= mask;
+    }
+    return Retire(m, NEXTPC, instr->rt, value);
+}
+
+static bool
+OpLb(Machine *m, Instruction *instr)
+{
+    return OpLoad(m, instr, 1, TRUE);
+}
+
+static bool
+OpLbu(Machine *m, Instruction *instr)
+{
+    return OpLoad(m, instr, 1, FALSE);
+}
+
+static bool
+OpLh(Machine *m, Instruction *instr)
+{
+    return OpLoad(m, instr, 2, TRUE);
+}
+
+static bool
+OpLhu(Machine *m, Instruction *instr)
+{
+    return OpLoad(m, instr, 2, FALSE);
+}
+
+static bool
+OpLw(Machine *m, Instruction *instr)
+{
+    return OpLoad(m, instr, 4, FALSE);
+}
+
+static bool
+OpStore(Machine *m, Instruction *instr, int size)
+{
+    if (!m->WriteMem((unsigned) (REG(rs) + instr->extra), size, REG(rt)))
+	return FALSE;
+    return Retire(m, NEXTPC, 0, 0);
+}
+
+static bool
+OpSb(Machine *m, Instruction *instr)
+{
+    return OpStore(m, instr, 1);
+}
+
+static bool
+OpSh(Machine *m, Instruction *instr)
+{
+    return OpStore(m, instr, 2);
+}
+
+static bool
+OpSw(Machine *m, Instruction *instr)
+{
+    return OpStore(m, instr, 4);
+}
+
+// Handler for each opcode, in the order of the definitions in mipssim.h
+
+static OpHandler opHandlers[MaxOpcode + 1] = {
+    OpGeneric,	OpAdd,		OpAddi,		OpAddiu,	// 0
+    OpAddu,	OpAnd,		OpAndi,		OpBeq,		// 4
+    OpBgez,	OpBgezal,	OpBgtz,		OpBlez,		// 8
+    OpBltz,	OpBltzal,	OpBne,		OpGeneric,	// 12
+    OpDiv,	OpDivu,		OpJ,		OpJal,		// 16
+    OpJalr,	OpJr,		OpLb,		OpLbu,		// 20
+    OpLh,	OpLhu,		OpLui,		OpLw,		// 24
+    OpGeneric,	OpGeneric,	OpGeneric,	OpMfhi,		// 28
+    OpMflo,	OpGeneric,	OpMthi,		OpMtlo,		// 32
+    OpMult,	OpMultu,	OpNor,		OpOr,		// 36
+    OpOri,	OpGeneric,	OpSb,		OpSh,		// 40
+    OpSll,	OpSllv,		OpSlt,		OpSlti,		// 44
+    OpSltiu,	OpSltu,		OpSra,		OpSrav,		// 48
+    OpSrl,	OpSrlv,		OpSub,		OpSubu,		// 52
+    OpSw,	OpGeneric,	OpGeneric,	OpXor,		// 56
+    OpXori,	OpGeneric,	OpGeneric,	OpGeneric,	// 60
+};
+
+//----------------------------------------------------------------------
+// EndsBlock
+// 	Return TRUE for instructions that may transfer control; the
+//	block ends with the instruction in their delay slot.
+//----------------------------------------------------------------------
+
+static bool
+EndsBlock(int opCode)
+{
+    switch (opCode) {
+      case OP_BEQ: case OP_BNE: case OP_BGEZ: case OP_BGEZAL:
+      case OP_BGTZ: case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL:
+      case OP_J: case OP_JAL: case OP_JR: case OP_JALR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::BuildBlock
+// 	Decode the basic block starting at a word of physical memory,
+//	attaching a handler to every instruction in it.  A block runs
+//	up to and including the delay slot of the first branch or jump,
+//	and never crosses the end of the physical page.
+//
+//	"word" -- index of the first instruction in mainMemory, in words
+//----------------------------------------------------------------------
+
+void
+Machine::BuildBlock(int word)
+{
+    int end = (word / (PageSize / 4) + 1) * (PageSize / 4);
+    int w;
+
+    for (w = word; w < end; w++) {
+	Instruction *instr = FetchDecoded(w * 4);
+
+	blockOps[w].handler = opHandlers[(int) instr->opCode];
+	if (EndsBlock(instr->opCode)) {
+	    if (++w < end) {		// include the delay slot
+		instr = FetchDecoded(w * 4);
+		blockOps[w].handler = opHandlers[(int) instr->opCode];
+		w++;
+	    }
+	    break;
+	}
+    }
+    blockOps[word].length = w - word;
+}
+
+//----------------------------------------------------------------------
+// Trace engine
+//
+//	Blocks entered more than HotBlockCount times are translated once
+//	into a Trace.  The routines below are the trace versions of the
+//	block engine handlers: they take their register operands as
+//	pointers and their immediates ready to use, so running a trace
+//	does no instruction field decoding at all.  Like the handlers,
+//	each applies the delayed load and advances the PCs on success.
+//----------------------------------------------------------------------
+
+#define HotBlockCount	16
+
+static bool
+TrFallback(Machine *m, TraceOp *op)
+{
+    return (*op->fallback)(m, op->instr);
+}
+
+static bool
+TrAddiu(Machine *m, TraceOp *op)
+{
+    *op->d = *op->s + op->imm;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrAddu(Machine *m, TraceOp *op)
+{
+    *op->d = *op->s + *op->t;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrSubu(Machine *m, TraceOp *op)
+{
+    *op->d = *op->s - *op->t;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrAnd(Machine *m, TraceOp *op)
+{
+    *op->d = *op->s & *op->t;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrOr(Machine *m, TraceOp *op)
+{
+    *op->d = *op->s | *op->t;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrXor(Machine *m, TraceOp *op)
+{
+    *op->d = *op->s ^ *op->t;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrNor(Machine *m, TraceOp *op)
+{
+    *op->d = ~(*op->s | *op->t);
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrAndi(Machine *m, TraceOp *op)
+{
+    *op->d = *op->s & op->imm;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrOri(Machine *m, TraceOp *op)
+{
+    *op->d = *op->s | op->imm;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrXori(Machine *m, TraceOp *op)
+{
+    *op->d = *op->s ^ op->imm;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrLui(Machine *m, TraceOp *op)
+{
+    *op->d = op->imm;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrSll(Machine *m, TraceOp *op)
+{
+    *op->d = *op->t << op->imm;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrSra(Machine *m, TraceOp *op)		// also SRL, as in Execute
+{
+    *op->d = *op->t >> op->imm;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrSlt(Machine *m, TraceOp *op)
+{
+    *op->d = (*op->s < *op->t) ? 1 : 0;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrSltu(Machine *m, TraceOp *op)
+{
+    *op->d = ((unsigned int) *op->s < (unsigned int) *op->t) ? 1 : 0;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrSlti(Machine *m, TraceOp *op)
+{
+    *op->d = (*op->s < op->imm) ? 1 : 0;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrSltiu(Machine *m, TraceOp *op)
+{
+    *op->d = ((unsigned int) *op->s < (unsigned int) op->imm) ? 1 : 0;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrBeq(Machine *m, TraceOp *op)
+{
+    return Retire(m, (*op->s == *op->t) ? op->imm
+		  : m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrBne(Machine *m, TraceOp *op)
+{
+    return Retire(m, (*op->s != *op->t) ? op->imm
+		  : m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrBgez(Machine *m, TraceOp *op)
+{
+    return Retire(m, !(*op->s & SIGN_BIT) ? op->imm
+		  : m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrBltz(Machine *m, TraceOp *op)
+{
+    return Retire(m, (*op->s & SIGN_BIT) ? op->imm
+		  : m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrBgtz(Machine *m, TraceOp *op)
+{
+    return Retire(m, (*op->s > 0) ? op->imm
+		  : m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrBlez(Machine *m, TraceOp *op)
+{
+    return Retire(m, (*op->s <= 0) ? op->imm
+		  : m->registers[NextPCReg] + 4, 0, 0);
+}
+
+static bool
+TrJ(Machine *m, TraceOp *op)
+{
+    return Retire(m, op->imm, 0, 0);
+}
+
+static bool
+TrJal(Machine *m, TraceOp *op)
+{
+    m->registers[R31] = m->registers[NextPCReg] + 4;
+    return Retire(m, op->imm, 0, 0);
+}
+
+static bool
+TrJr(Machine *m, TraceOp *op)
+{
+    return Retire(m, *op->s, 0, 0);
+}
+
+static bool
+TrLw(Machine *m, TraceOp *op)
+{
+    int addr = *op->s + op->imm;
+    int value;
+
+    if (addr & 0x3) {
+	m->RaiseException(AddressErrorException, addr);
+	return FALSE;
+    }
+    if (!m->ReadMem(addr, 4, &value))
+	return FALSE;
+    return Retire(m, m->registers[NextPCReg] + 4, op->t - m->registers, value);
+}
+
+static bool
+TrSw(Machine *m, TraceOp *op)
+{
+    if (!m->WriteMem((unsigned) (*op->s + op->imm), 4, *op->t))
+	return FALSE;
+    return Retire(m, m->registers[NextPCReg] + 4, 0, 0);
+}
+
+//----------------------------------------------------------------------
+// Machine::TranslateBlock
+// 	Translate the (already built) basic block starting at a word of
+//	physical memory into a Trace.  The trace is thrown away with the
+//	rest of the frame's cached state by InvalidateFrame.
+//
+//	"word" -- index of the first instruction in mainMemory, in words
+//	"vaddr" -- the virtual address the block is running at
+//----------------------------------------------------------------------
+
+void
+Machine::TranslateBlock(int word, int vaddr)
+{
+    Trace *trace = new Trace(vaddr, blockOps[word].length);
+
+    for (int i = 0; i < trace->length; i++) {
+	Instruction *instr = &decodeCache[word + i];
+	TraceOp *op = &trace->ops[i];
+	int pc = vaddr + i * 4;
+
+	op->s = &registers[(int) instr->rs];
+	op->t = &registers[(int) instr->rt];
+	op->d = &registers[(int) instr->rd];
+	op->imm = instr->extra;
+	op->fallback = blockOps[word + i].handler;
+	op->instr = instr;
+	switch (instr->opCode) {
+	  case OP_ADDIU: op->run = TrAddiu; op->d = op->t; break;
+	  case OP_ADDU:	op->run = TrAddu; break;
+	  case OP_SUBU:	op->run = TrSubu; break;
+	  case OP_AND:	op->run = TrAnd; break;
+	  case OP_OR:	op->run = TrOr; break;
+	  case OP_XOR:	op->run = TrXor; break;
+	  case OP_NOR:	op->run = TrNor; break;
+	  case OP_ANDI:	op->run = TrAndi; op->d = op->t; op->imm &= 0xffff; break;
+	  case OP_ORI:	op->run = TrOri; op->d = op->t; op->imm &= 0xffff; break;
+	  case OP_XORI:	op->run = TrXori; op->d = op->t; op->imm &= 0xffff; break;
+	  case OP_LUI:	op->run = TrLui; op->d = op->t; op->imm <<= 16; break;
+	  case OP_SLL:	op->run = TrSll; break;
+	  case OP_SRA:
+	  case OP_SRL:	op->run = TrSra; break;
+	  case OP_SLT:	op->run = TrSlt; break;
+	  case OP_SLTU:	op->run = TrSltu; break;
+	  case OP_SLTI:	op->run = TrSlti; op->d = op->t; break;
+	  case OP_SLTIU: op->run = TrSltiu; op->d = op->t; break;
+	  case OP_LW:	op->run = TrLw; break;
+	  case OP_SW:	op->run = TrSw; break;
+	  case OP_JR:	op->run = TrJr; break;
+	  case OP_BEQ: case OP_BNE: case OP_BGEZ:
+	  case OP_BLTZ: case OP_BGTZ: case OP_BLEZ:
+	    // the block runs sequentially, so NextPC here is pc + 4
+	    op->imm = pc + 4 + IndexToAddr(instr->extra);
+	    switch (instr->opCode) {
+	      case OP_BEQ:	op->run = TrBeq; break;
+	      case OP_BNE:	op->run = TrBne; break;
+	      case OP_BGEZ:	op->run = TrBgez; break;
+	      case OP_BLTZ:	op->run = TrBltz; break;
+	      case OP_BGTZ:	op->run = TrBgtz; break;
+	      default:		op->run = TrBlez; break;
+	    }
+	    break;
+	  case OP_J:
+	  case OP_JAL:
+	    op->imm = ((pc + 8) & 0xf0000000) | IndexToAddr(instr->extra);
+	    op->run = (instr->opCode == OP_J) ? TrJ : TrJal;
+	    break;
+	  default:
+	    op->run = TrFallback;
+	    break;
+	}
+    }
+    blockOps[word].trace = trace;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlock
+// 	Run the basic block that starts at the current PC, one simulated
+//	tick per instruction, just as Run would with OneInstruction.
+//
+//	Only the first instruction is fetched through Translate.  For
+//	the rest of the block we repeat the side effects a fetch from the
+//	same page would have (TLB hit count, time stamp, use bit), as long
+//	as no translation or decoded frame has changed since -- otherwise
+//	we stop and the next block starts with a full fetch.  We also stop
+//	at the first instruction that traps to the kernel.
+//
+//	If the PC is in a delay slot, only that instruction is run.
+//	Under the trace engine, hot blocks are translated and run from
+//	their Trace instead of through the block handlers.
+//----------------------------------------------------------------------
+
+void
+Machine::RunBlock()
+{
+    int pc = registers[PCReg];
+    int physAddr, word, length, i;
+    unsigned int epoch, frames;
+    TranslationEntry *codeEntry;
+    Trace *trace = NULL;
+    ExceptionType exception;
+
+    exception = Translate(pc, &physAddr, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, pc);
+	UserTickDone();
+	return;
+    }
+    codeEntry = lastEntry;
+    epoch = translationEpoch;
+    frames = frameEpoch;
+    word = physAddr / 4;
+    if (blockOps[word].length == 0)
+	BuildBlock(word);
+    if (registers[NextPCReg] != pc + 4)
+	length = 1;
+    else {
+	length = blockOps[word].length;
+	if (engine == TraceEngine && blockOps[word].trace == NULL
+		&& ++blockOps[word].count > HotBlockCount)
+	    TranslateBlock(word, pc);
+	trace = blockOps[word].trace;
+	if (trace != NULL && trace->vaddr != pc)
+	    trace = NULL;
+    }
+
+    for (i = 0; i < length; i++) {
+	bool ok;
+
+	if (i > 0) {
+	    if (epoch != translationEpoch || frames != frameEpoch)
+		return;
+	    if (tlb != NULL) {
+		stats->tlbHits++;
+		codeEntry->t = stats->totalTicks;
+	    }
+	    codeEntry->use = TRUE;
+	}
+	if (trace != NULL)
+	    ok = (*trace->ops[i].run)(this, &trace->ops[i]);
+	else
+	    ok = (*blockOps[word + i].handler)(this, &decodeCache[word + i]);
+	UserTickDone();
+	if (!ok)
+	    return;
+    }
+}
+
 //----------------------------------------------------------------------
 // Mult
 // 	Simulate R2000 multiplication.
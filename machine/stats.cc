@@ -20,9 +20,14 @@ Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
     numDiskReads = numDiskWrites = 0;
+    numCacheHits = numCacheMisses = numCacheWriteBacks = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
-    numPageFaults = numPacketsSent = numPacketsRecvd = 0;
-    tlbMiss = tlbHits = pageSwaps = 0;
+    numPageFaults = numZeroFills = numPacketsSent = numPacketsRecvd = 0;
+    tlbMiss = tlbHits = pageSwaps = numCopyOnWrites = numTextShares = 0;
+    numPrefetches = numPrefetchHits = numFaultArounds = numFaultAroundHits = 0;
+    numSyncEvictions = numPageouts = numPreCleans = 0;
+    numContextSwitches = tlbMissesSaved = 0;
+    tlb2Hits = tlb2Misses = tlbWalks = 0;
 }
 
 //----------------------------------------------------------------------
@@ -37,12 +42,35 @@ Statistics::Print()
     printf("Ticks: total %d, idle %d, system %d, user %d\n", totalTicks, 
 	idleTicks, systemTicks, userTicks);
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
+    if (numCacheHits + numCacheMisses > 0)
+	printf("Block cache: hits %d, misses %d, hit rate %.2f%%, "
+	    "sectors written back %d\n", numCacheHits, numCacheMisses,
+	    (float)numCacheHits / (numCacheHits + numCacheMisses) * 100,
+	    numCacheWriteBacks);
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
-    printf("Paging: faults %d\n", numPageFaults);
+    printf("Paging: faults %d (%d zero-filled, %d shared code), %.3f per "
+	"1000 user instructions\n", numPageFaults, numZeroFills, numTextShares,
+	userTicks ? numPageFaults * 1000.0 / userTicks : 0.0);
+    printf("Prefetch: pages %d, used %d; fault-around: TLB entries %d, "
+	"used %d\n", numPrefetches, numPrefetchHits, numFaultArounds,
+	numFaultAroundHits);
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
     printf("TLB Miss: %d, TLB Hits: %d, Miss Rate: %f%%\n",
         tlbMiss, tlbHits, (float)tlbMiss/(tlbHits+tlbMiss)*100);
-    printf("Page Swaps: %d\n", pageSwaps);
+    if (tlbWalks > 0)
+	printf("Page table walks: %d, TLB misses trapped to the kernel: %d\n",
+	    tlbWalks, tlbMiss - tlb2Hits - tlbWalks);
+    if (tlb2Hits + tlb2Misses > 0)
+	printf("L2 TLB: hits %d, misses %d, hit rate %.2f%%\n", tlb2Hits,
+	    tlb2Misses, (float)tlb2Hits / (tlb2Hits + tlb2Misses) * 100);
+    printf("Context switches: %d, TLB misses per switch %.2f, saved by "
+	"keeping the TLB %.2f\n", numContextSwitches,
+	numContextSwitches ? (float)tlbMiss / numContextSwitches : 0.0,
+	numContextSwitches ? (float)tlbMissesSaved / numContextSwitches : 0.0);
+    printf("Page Swaps: %d, copy-on-write copies: %d\n", pageSwaps,
+	numCopyOnWrites);
+    printf("Pageout: evictions %d by faulting threads, %d by the daemon, "
+	"%d pages pre-cleaned\n", numSyncEvictions, numPageouts, numPreCleans);
 }
@@ -30,15 +30,37 @@ class Statistics {
 
     int numDiskReads;		// number of disk read requests
     int numDiskWrites;		// number of disk write requests
+    int numCacheHits;		// sector accesses the block cache served
+    int numCacheMisses;		// ... and those it had to make room for
+    int numCacheWriteBacks;	// dirty sectors it wrote to disk
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numZeroFills;		// page faults served by clearing a frame
+    int numCopyOnWrites;	// pages copied after a fork
+    int numTextShares;		// page faults served by another process's
+				// copy of a code page
+    int numPrefetches;		// pages brought in ahead of a fault
+    int numPrefetchHits;	// ... that were then used
+    int numFaultArounds;	// TLB entries loaded ahead of a miss
+    int numFaultAroundHits;	// ... that were then used
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
 
     int tlbHits;
     int tlbMiss;
-    int pageSwaps;
+    int tlb2Hits;		// TLB misses the L2 TLB served
+    int tlb2Misses;		// ... and those it could not
+    int tlbWalks;		// TLB misses the hardware page table
+				// walker served without a trap
+    int numContextSwitches;	// times Scheduler::Run switched threads
+    int tlbMissesSaved;		// TLB hits on entries loaded before the
+				// latest switch, that a flush would have
+				// turned into misses
+    int pageSwaps;		// pages evicted from memory
+    int numSyncEvictions;	// ... of those, by a faulting thread
+    int numPageouts;		// ... and by the pageout daemon
+    int numPreCleans;		// dirty pages written back ahead of eviction
     Statistics(); 		// initialize everything to zero
 
     void Print();		// print collected statistics
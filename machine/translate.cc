@@ -71,6 +71,52 @@ unsigned short
 ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 
 
+//----------------------------------------------------------------------
+// LoadHost, StoreHost
+// 	Read or write "size" (1, 2, or 4) bytes of simulated memory that
+//	is at host address "p", converting to and from the simulated
+//	machine's byte order.
+//----------------------------------------------------------------------
+
+static inline int
+LoadHost(char *p, int size)
+{
+	switch (size) {
+		case 1:
+		return *p;
+
+		case 2:
+		return ShortToHost(*(unsigned short *) p);
+
+		case 4:
+		return WordToHost(*(unsigned int *) p);
+
+		default: ASSERT(FALSE);
+	}
+	return 0;
+}
+
+static inline void
+StoreHost(char *p, int size, int value)
+{
+	switch (size) {
+		case 1:
+		*p = (unsigned char) (value & 0xff);
+		break;
+
+		case 2:
+		*(unsigned short *) p
+		= ShortToMachine((unsigned short) (value & 0xffff));
+		break;
+
+		case 4:
+		*(unsigned int *) p = WordToMachine((unsigned int) value);
+		break;
+
+		default: ASSERT(FALSE);
+	}
+}
+
 //----------------------------------------------------------------------
 // Machine::ReadMem
 //      Read "size" (1, 2, or 4) bytes of virtual memory at "addr" into 
@@ -87,9 +133,14 @@ ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 bool
 Machine::ReadMem(int addr, int size, int *value)
 {
-	int data;
 	ExceptionType exception;
 	int physicalAddress;
+	char *host = SoftTranslate(addr, size, FALSE);
+
+	if (host != NULL) {		// the common case
+		*value = LoadHost(host, size);
+		return TRUE;
+	}
 
 	DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
 
@@ -98,104 +149,122 @@ Machine::ReadMem(int addr, int size, int *value)
 		machine->RaiseException(exception, addr);
 		return FALSE;
 	}
-	switch (size) {
-		case 1:
-		data = machine->mainMemory[physicalAddress];
-		*value = data;
-		break;
-
-		case 2:
-		data = *(unsigned short *) &machine->mainMemory[physicalAddress];
-		*value = ShortToHost(data);
-		break;
-
-		case 4:
-		data = *(unsigned int *) &machine->mainMemory[physicalAddress];
-		*value = WordToHost(data);
-		break;
-
-		default: ASSERT(FALSE);
-	}
+	*value = LoadHost(&mainMemory[physicalAddress], size);
 
 	DEBUG('a', "\tvalue read = %8.8x\n", *value);
 	return (TRUE);
 }
 
-static bool ReadMemNoExcept(int addr, int size, char *val)
+//----------------------------------------------------------------------
+// Machine::UserBytes
+// 	Find where a run of user virtual memory lives in mainMemory, on
+//	behalf of the kernel.  The run stops at the end of the page, so
+//	the caller copies a page at a time and calls us again for the
+//	rest.  Pages that are not resident are faulted in first.
+//
+//	Returns the host address of the first byte, or NULL if the address
+//	is bad.  Sets *count to the number of bytes (at most "len") that
+//	can be copied from there.
+//
+//	"addr" -- the user virtual address
+//	"len" -- how many bytes the caller still wants
+//	"writing" -- TRUE if the kernel is going to store into the bytes
+//----------------------------------------------------------------------
+
+char *
+Machine::UserBytes(int addr, int len, bool writing, int *count)
 {
-	int data;
 	ExceptionType exception;
 	int physicalAddress;
-	exception = machine->Translate(addr, &physicalAddress, size, FALSE);
-	if (exception != NoException)
-	{
-		while(exception == PageFaultException)
-		{
-			machine->RaiseException(exception, addr);
-			exception = machine->Translate(addr, &physicalAddress, size, FALSE);
-		}
-		if(exception != NoException) return FALSE;
-	}
-	switch (size)
-	{
-		case 1:
-		data = machine->mainMemory[physicalAddress];
-		*val = data;
-		break;
+	int inPage = PageSize - (unsigned) addr % PageSize;
 
-		case 2:
-		data = *(unsigned short *) &machine->mainMemory[physicalAddress];
-		*val = ShortToHost(data);
-		break;
-
-		case 4:
-		data = *(unsigned int *) &machine->mainMemory[physicalAddress];
-		*val = WordToHost(data);
-		break;
-
-		default: ASSERT(FALSE);
+	exception = Translate(addr, &physicalAddress, 1, writing);
+	while (exception == PageFaultException
+	       || exception == ReadOnlyException) {	// maybe copy-on-write
+		RaiseException(exception, addr);
+		exception = Translate(addr, &physicalAddress, 1, writing);
 	}
-	return TRUE;
+	if (exception != NoException)
+		return NULL;
+	*count = (len < inPage) ? len : inPage;
+	return &mainMemory[physicalAddress];
 }
 
+//----------------------------------------------------------------------
+// Machine::ReadMemStr
+//      Copy a null-terminated string out of user memory, in one pass
+//	and a page at a time.
+//
+//   	Returns FALSE if part of the string is at a bad address.
+//
+//	"addr" -- the user virtual address of the string
+//	"len" -- if not NULL, set to the length including the terminator
+//	"buf" -- set to a new array holding the string; the caller must
+//		delete it
+//----------------------------------------------------------------------
+
 bool
 Machine::ReadMemStr(int addr, int *len, char* &buf)
 {
 	DEBUG('a', "Reading str at VA 0x%x\n", addr);
 
-	int l = 0;
-	char c;
+	int l = 0, size = 32, count;
+	char *host, *end;
+
+	buf = new char[size];
 	while(true)
 	{
-		if(!ReadMemNoExcept(addr+l, 1, &c))
+		if((host = UserBytes(addr + l, PageSize, FALSE, &count)) == NULL)
+		{
+			delete[] buf;
+			buf = NULL;
 			return FALSE;
-		l++;
-		if(!c) break;
+		}
+		end = (char *) memchr(host, '\0', count);
+		if(end != NULL)
+			count = end - host + 1;
+		if(l + count > size)
+		{
+			char *bigger;
+
+			while(l + count > size)
+				size *= 2;
+			bigger = new char[size];
+			memcpy(bigger, buf, l);
+			delete[] buf;
+			buf = bigger;
+		}
+		memcpy(buf + l, host, count);
+		l += count;
+		if(end != NULL) break;
 	}
 	if(len) *len=l;
-	buf = new char[l+1];
-	l = 0;
-	while(true)
-	{
-		char c;
-		if(!ReadMemNoExcept(addr+l, 1, &c))
-			return FALSE;
-		buf[l++] = c;
-		if(!c) break;
-	}
 
 	DEBUG('a', "\tstr read = %s\n", buf);
 	return (TRUE);
 }
+
+//----------------------------------------------------------------------
+// Machine::ReadMemArr
+//      Copy "len" bytes of user memory at "addr" into the kernel
+//	buffer "value", a page at a time.
+//
+//   	Returns FALSE if part of the range is at a bad address.
+//----------------------------------------------------------------------
+
 bool
 Machine::ReadMemArr(int addr, int len, char* value)
 {
 	DEBUG('a', "Reading array at VA 0x%x\n", addr);
 
-	for(int i = 0; i < len; i++)
+	int done, count;
+	char *host;
+
+	for(done = 0; done < len; done += count)
 	{
-		if(!ReadMemNoExcept(addr+i, 1, value+i))
+		if((host = UserBytes(addr + done, len - done, FALSE, &count)) == NULL)
 			return FALSE;
+		memcpy(value + done, host, count);
 	}
 	return (TRUE);
 }
@@ -218,6 +287,13 @@ Machine::WriteMem(int addr, int size, int value)
 {
 	ExceptionType exception;
 	int physicalAddress;
+	char *host = SoftTranslate(addr, size, TRUE);
+
+	if (host != NULL) {		// the common case
+		StoreHost(host, size, value);
+		InvalidateFrame((host - mainMemory) / PageSize);
+		return TRUE;
+	}
 
 	DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
 
@@ -226,70 +302,34 @@ Machine::WriteMem(int addr, int size, int value)
 		machine->RaiseException(exception, addr);
 		return FALSE;
 	}
-	switch (size) {
-		case 1:
-		machine->mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
-		break;
-
-		case 2:
-		*(unsigned short *) &machine->mainMemory[physicalAddress]
-		= ShortToMachine((unsigned short) (value & 0xffff));
-		break;
-
-		case 4:
-		*(unsigned int *) &machine->mainMemory[physicalAddress]
-		= WordToMachine((unsigned int) value);
-		break;
-
-		default: ASSERT(FALSE);
-	}
+	StoreHost(&mainMemory[physicalAddress], size, value);
+	InvalidateFrame(physicalAddress / PageSize);
 
 	return TRUE;
 }
 
-static bool WriteMemNoExcept(int addr, int size, int value)
-{
-	int data;
-	ExceptionType exception;
-	int physicalAddress;
-	exception = machine->Translate(addr, &physicalAddress, size, TRUE);
-	if (exception != NoException)
-	{
-		while(exception == PageFaultException)
-		{
-			machine->RaiseException(exception, addr);
-			exception = machine->Translate(addr, &physicalAddress, size, TRUE);
-		}
-		if(exception != NoException) return FALSE;
-	}
-	switch (size) {
-		case 1:
-		machine->mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
-		break;
-
-		case 2:
-		*(unsigned short *) &machine->mainMemory[physicalAddress]
-		= ShortToMachine((unsigned short) (value & 0xffff));
-		break;
-
-		case 4:
-		*(unsigned int *) &machine->mainMemory[physicalAddress]
-		= WordToMachine((unsigned int) value);
-		break;
+//----------------------------------------------------------------------
+// Machine::WriteMemArr
+//      Copy "len" bytes from the kernel buffer "value" into user memory
+//	at "addr", a page at a time.
+//
+//   	Returns FALSE if part of the range is at a bad address.
+//----------------------------------------------------------------------
 
-		default: ASSERT(FALSE);
-	}
-	return TRUE;
-}
 bool
 Machine::WriteMemArr(int addr, int len, char* value)
 {
-	DEBUG('a', "Reading array at VA 0x%x\n", addr);
+	DEBUG('a', "Writing array at VA 0x%x\n", addr);
+
+	int done, count;
+	char *host;
 
-	for(int i = 0; i < len; i++)
+	for(done = 0; done < len; done += count)
 	{
-		if(!WriteMemNoExcept(addr+i, 1, (int)value[i]))
+		if((host = UserBytes(addr + done, len - done, TRUE, &count)) == NULL)
 			return FALSE;
+		memcpy(host, value + done, count);
+		InvalidateFrame((host - mainMemory) / PageSize);
 	}
 	return (TRUE);
 }
@@ -313,9 +353,15 @@ ExceptionType
 Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 {
 	int i;
-	unsigned int vpn, offset;
+	unsigned int vpn, offset, idx;
 	TranslationEntry *entry;
 	unsigned int pageFrame;
+	char *host = SoftTranslate(virtAddr, size, writing);
+
+	if (host != NULL) {
+		*physAddr = host - mainMemory;
+		return NoException;
+	}
 
 	DEBUG('a', "\tTranslate 0x%x, %s: ", virtAddr, writing ? "write" : "read");
 
@@ -336,14 +382,14 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 
 	if (tlb == NULL)
     {		// => page table => vpn is index into table
-    	unsigned int idx = find(vpn, currentThread->space->tid);
+    	idx = find(vpn, currentThread->space->tid);
     	if (vpn >= pageTableSize)
     	{
     		DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
     			virtAddr, pageTableSize);
     		return AddressErrorException;
     	}
-    	else if (idx >= NumPhysPages)
+    	else if (idx >= (unsigned) NumPhysPages)
     	{
     		DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
     			virtAddr, pageTableSize);
@@ -367,17 +413,55 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     	}
 		if (entry == NULL)
 		{				// not found
-			DEBUG('a', "*** no valid TLB entry found for this virtual page!\n");
 			stats->tlbMiss++;
-			return PageFaultException;
+			if (tlb2 != NULL && (entry = tlb2->Lookup(vpn,
+				currentThread->space->tid)) != NULL)
+			{		// the hardware refills from the L2 TLB
+				stats->tlb2Hits++;
+				i = TLBVictim();
+				FillTLB(i, entry);
+				entry->t = stats->totalTicks;
+			}
+			else if (HardwareWalk && (idx = find(vpn,
+				currentThread->space->tid)) < (unsigned) NumPhysPages)
+			{		// the hardware walks the page table
+				if (tlb2 != NULL) {
+					stats->tlb2Misses++;
+					tlb2->Insert(&InvPageTable[idx]);
+				}
+				stats->tlbWalks++;
+				entry = &InvPageTable[idx];
+				i = TLBVictim();
+				FillTLB(i, entry);
+				entry->mappedAhead = FALSE;
+				entry->t = stats->totalTicks;
+			}
+			else
+			{
+				if (tlb2 != NULL)
+					stats->tlb2Misses++;
+				DEBUG('a', "*** no valid TLB entry found for this virtual page!\n");
+				return PageFaultException;
 						// really, this is a TLB fault,
 						// the page may be in memory,
 						// but not in the TLB
+			}
 		}
 		else
 		{
 			stats->tlbHits++;
 			entry->t=stats->totalTicks;
+			if (tlbSwitch[i] != stats->numContextSwitches) {
+				// loaded before a switch: once, we would have
+				// missed here if switches flushed the TLB
+				tlbSwitch[i] = stats->numContextSwitches;
+				stats->tlbMissesSaved++;
+			}
+			if (entry->mappedAhead) {	// fault-around paid off
+				entry->mappedAhead = FALSE;
+				stats->numFaultAroundHits++;
+				currentThread->space->aroundUsed++;
+			}
 		}
 	}
 
@@ -389,54 +473,397 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 
     // if the pageFrame is too big, there is something really wrong! 
     // An invalid translation was loaded into the page table or TLB. 
-    if (pageFrame >= NumPhysPages) { 
+    if (pageFrame >= (unsigned) NumPhysPages) { 
     	DEBUG('a', "*** frame %d > %d!\n", pageFrame, NumPhysPages);
     	return BusErrorException;
     }
     entry->use = TRUE;		// set the use, dirty bits
     if (writing)
     	entry->dirty = TRUE;
+    if (entry->prefetched) {	// prefetching paid off
+	entry->prefetched = FALSE;
+	stats->numPrefetchHits++;
+    }
+    lastEntry = entry;
     *physAddr = pageFrame * PageSize + offset;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
     DEBUG('a', "phys addr = 0x%x\n", *physAddr);
+
+    // remember the translation, unless we are tracing every lookup
+    if (!DebugIsEnabled('a')) {
+	SoftTLBEntry *soft = &softTlb[vpn & (SoftTLBSize - 1)];
+
+	soft->vpn = vpn;
+	soft->epoch = translationEpoch;
+	soft->entry = entry;
+	soft->frame = &mainMemory[pageFrame * PageSize];
+	soft->writable = !entry->readOnly;
+    }
     return NoException;
 }
 
+//----------------------------------------------------------------------
+// Machine::SoftTranslate
+// 	Translate a virtual address using only the soft TLB, the cache
+//	of translations Translate has recently completed.  On a hit we
+//	have the same effect on the statistics and on the translation
+//	entry that Translate would have had -- TLB hit count, time stamp,
+//	use and dirty bits -- so the kernel's reference data stays exact.
+//
+//	Returns the host address of the byte in mainMemory, or NULL if
+//	the caller must go through Translate (a miss, a misaligned
+//	reference, or a write to a read-only page).
+//
+//	"virtAddr" -- the virtual address to translate
+//	"size" -- the amount of memory being read or written
+// 	"writing" -- if TRUE, the page must be writable
+//----------------------------------------------------------------------
+
+char *
+Machine::SoftTranslate(int virtAddr, int size, bool writing)
+{
+	unsigned int vpn = (unsigned) virtAddr >> PageShift;
+	SoftTLBEntry *soft = &softTlb[vpn & (SoftTLBSize - 1)];
+
+	if (soft->epoch != translationEpoch || soft->vpn != vpn
+	    || (writing && !soft->writable)
+	    || ((size == 4) && (virtAddr & 0x3))
+	    || ((size == 2) && (virtAddr & 0x1)))
+		return NULL;
+
+	if (tlb != NULL) {
+		stats->tlbHits++;
+		soft->entry->t = stats->totalTicks;
+	}
+	soft->entry->use = TRUE;
+	if (writing)
+		soft->entry->dirty = TRUE;
+	lastEntry = soft->entry;
+	return soft->frame + (virtAddr & (PageSize - 1));
+}
+
+//----------------------------------------------------------------------
+// Machine::getnew, Machine::find, Machine::remove
+// 	The kernel's interface to the inverted page table.  Entries are
+//	named by their index in InvPageTable; an index of NumPhysPages
+//	means there is no such entry.
+//
+//	getnew takes a free entry and links it in for <tid, vpn>; the
+//	caller fills in the rest.  find looks <tid, vpn> up.  remove
+//	unlinks an entry and frees it.
+//----------------------------------------------------------------------
+
 unsigned int Machine::getnew(unsigned int vpn, int tid)
 {
-	unsigned int pn = addrhash(vpn);
-    if(InvPageTable[pn].valid)
-    {
-    	int i = 0;
-        unsigned int j = rehash(tid);
-        do
-        {
-            pn += j;
-            pn %= NumPhysPages;
-            i++;
-            if(i >= NumPhysPages) break;
-        }while(InvPageTable[pn].valid);
-    }
-    if(InvPageTable[pn].valid) return NumPhysPages;
-    return pn;
+	int idx = pageHash->Allocate();
+
+	if(idx == -1) return NumPhysPages;
+	InvPageTable[idx].virtualPage = vpn;
+	InvPageTable[idx].tid = tid;
+	pageHash->Link(idx);
+	return idx;
 }
+
 unsigned int Machine::find(unsigned int vpn, int tid)
 {
-	unsigned int pn = addrhash(vpn);
-	unsigned int j = rehash(tid);
-	int i = 0;
-	while(InvPageTable[pn].valid || InvPageTable[pn].tomb)
+	int idx = pageHash->Lookup(vpn, tid);
+
+	return (idx == -1) ? NumPhysPages : idx;
+}
+
+void Machine::remove(unsigned int idx)
+{
+	pageHash->Unlink(idx);
+	pageHash->Free(idx);
+	FlushTLBEntry(&InvPageTable[idx]);
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushTLBEntry
+// 	Empty the TLB slot holding "entry", if any.  TLB entries are
+//	tagged with the tid of their address space and survive context
+//	switches, so a page table entry must leave the TLB when its page
+//	leaves memory -- not that a stale slot could translate anything,
+//	since Translate checks the entry, but it wastes the slot.
+//----------------------------------------------------------------------
+
+void Machine::FlushTLBEntry(TranslationEntry *entry)
+{
+	if(tlb == NULL) return;
+	for(int i = 0; i < TLBSize; i++)
+		if(tlb[i] == entry)
+			tlb[i] = NULL;
+	if(tlb2 != NULL)
+		tlb2->Flush(entry);
+}
+
+//----------------------------------------------------------------------
+// Machine::TLBVictim, Machine::FillTLB
+// 	Refill the (first level) TLB, for the kernel's miss handler or
+//	from the L2 TLB.  TLBVictim picks the slot to use: an empty one if
+//	there is one, otherwise the least recently used.  FillTLB puts
+//	"entry" there; the soft TLB must then forget the entry it replaces,
+//	or it would go on counting hits on a page no longer in the TLB.
+//----------------------------------------------------------------------
+
+int Machine::TLBVictim()
+{
+	int pos = 0;
+
+	for(int i = 0; i < TLBSize; i++)
 	{
-		if(InvPageTable[pn].valid)
-		{
-			if(InvPageTable[pn].tid == tid &&
-				InvPageTable[pn].virtualPage == vpn)
-				return pn;
-		}
-		pn += j;
-		pn %= NumPhysPages;
-		i++;
-		if(i >= NumPhysPages) break;
+		if(tlb[i] == NULL)
+			return i;
+		if(tlb[pos]->t > tlb[i]->t)
+			pos = i;
+	}
+	return pos;
+}
+
+void Machine::FillTLB(int slot, TranslationEntry *entry)
+{
+	if(tlb[slot] != NULL && tlb[slot] != entry)
+	{
+		tlb[slot]->mappedAhead = FALSE;	// replaced before it was used
+		InvalidateTranslations();
 	}
-	return NumPhysPages;
-}
\ No newline at end of file
+	tlb[slot] = entry;
+	tlbSwitch[slot] = stats->numContextSwitches;
+}
+//----------------------------------------------------------------------
+// HashedPageTable::HashedPageTable
+// 	Initialize an empty inverted page table.
+//
+//	"entryCount" -- the most translations the table can hold at once
+//----------------------------------------------------------------------
+
+HashedPageTable::HashedPageTable(int entryCount)
+{
+    int i;
+
+    numEntries = entryCount;
+    for (numBuckets = 1; numBuckets < numEntries; numBuckets <<= 1)
+	;
+    entries = new TranslationEntry[numEntries];
+    next = new int[numEntries];
+    bucket = new int[numBuckets];
+    for (i = 0; i < numBuckets; i++)
+	bucket[i] = -1;
+    freeList = -1;
+    for (i = numEntries - 1; i >= 0; i--) {
+	entries[i].valid = FALSE;
+	entries[i].t = 0;
+	next[i] = freeList;
+	freeList = i;
+    }
+}
+
+//----------------------------------------------------------------------
+// HashedPageTable::~HashedPageTable
+// 	De-allocate the table.
+//----------------------------------------------------------------------
+
+HashedPageTable::~HashedPageTable()
+{
+    delete [] entries;
+    delete [] next;
+    delete [] bucket;
+}
+
+//----------------------------------------------------------------------
+// HashedPageTable::Hash
+// 	Pick the bucket for <tid, vpn>.  Consecutive pages of one thread
+//	land in different buckets, and so do the same page of different
+//	threads.
+//----------------------------------------------------------------------
+
+int
+HashedPageTable::Hash(int vpn, int tid)
+{
+    unsigned int h = (unsigned) vpn * 0x9E3779B9 ^ (unsigned) tid * 0x85EBCA6B;
+
+    h ^= h >> 16;
+    return h & (numBuckets - 1);
+}
+
+//----------------------------------------------------------------------
+// HashedPageTable::Lookup
+// 	Return the index of the entry translating virtual page "vpn" of
+//	thread "tid", or -1 if the page is not resident.
+//----------------------------------------------------------------------
+
+int
+HashedPageTable::Lookup(int vpn, int tid)
+{
+    for (int i = bucket[Hash(vpn, tid)]; i != -1; i = next[i])
+	if (entries[i].virtualPage == vpn && entries[i].tid == tid)
+	    return i;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// HashedPageTable::Allocate
+// 	Take an entry off the free list.  It is not linked into the
+//	table until the caller fills it in and calls Link.
+//----------------------------------------------------------------------
+
+int
+HashedPageTable::Allocate()
+{
+    int idx = freeList;
+
+    if (idx != -1) {
+	freeList = next[idx];
+	next[idx] = -1;
+    }
+    return idx;
+}
+
+//----------------------------------------------------------------------
+// HashedPageTable::Link
+// 	Put an entry on the chain for its <tid, virtualPage>.
+//----------------------------------------------------------------------
+
+void
+HashedPageTable::Link(int idx)
+{
+    int b = Hash(entries[idx].virtualPage, entries[idx].tid);
+
+    next[idx] = bucket[b];
+    bucket[b] = idx;
+}
+
+//----------------------------------------------------------------------
+// HashedPageTable::Unlink
+// 	Take an entry off its chain.  The entry must have the same
+//	virtualPage and tid it was linked with.
+//----------------------------------------------------------------------
+
+void
+HashedPageTable::Unlink(int idx)
+{
+    int *link = &bucket[Hash(entries[idx].virtualPage, entries[idx].tid)];
+
+    while (*link != idx) {
+	ASSERT(*link != -1);
+	link = &next[*link];
+    }
+    *link = next[idx];
+    next[idx] = -1;
+}
+
+//----------------------------------------------------------------------
+// HashedPageTable::Free
+// 	Return an unlinked entry to the free list.
+//----------------------------------------------------------------------
+
+void
+HashedPageTable::Free(int idx)
+{
+    entries[idx].valid = FALSE;
+    next[idx] = freeList;
+    freeList = idx;
+}
+
+//----------------------------------------------------------------------
+// SetAssocTLB::SetAssocTLB
+// 	Initialize an empty second level TLB.
+//
+//	"numEntries" -- total slots; a multiple of "ways"
+//	"ways" -- slots per set
+//	"policy" -- which slot of a full set Insert replaces
+//----------------------------------------------------------------------
+
+SetAssocTLB::SetAssocTLB(int numEntries, int w, TLBReplace p)
+{
+    ASSERT(w > 0 && numEntries >= w && numEntries % w == 0);
+    ways = w;
+    numSets = numEntries / w;
+    policy = p;
+    clock = 0;
+    slots = new TranslationEntry*[numEntries];
+    stamp = new unsigned int[numEntries];
+    for (int i = 0; i < numEntries; i++) {
+	slots[i] = NULL;
+	stamp[i] = 0;
+    }
+}
+
+//----------------------------------------------------------------------
+// SetAssocTLB::~SetAssocTLB
+// 	De-allocate the slots.
+//----------------------------------------------------------------------
+
+SetAssocTLB::~SetAssocTLB()
+{
+    delete [] slots;
+    delete [] stamp;
+}
+
+//----------------------------------------------------------------------
+// SetAssocTLB::Lookup
+// 	Search the set of "vpn" for a valid entry mapping <tid, vpn>.
+//	A hit counts as a use for LRU.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+SetAssocTLB::Lookup(int vpn, int tid)
+{
+    int first = (vpn % numSets) * ways;
+
+    clock++;
+    for (int i = first; i < first + ways; i++) {
+	TranslationEntry *e = slots[i];
+
+	if (e != NULL && e->valid && e->virtualPage == vpn && e->tid == tid) {
+	    if (policy == TLBReplaceLRU)
+		stamp[i] = clock;
+	    return e;
+	}
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// SetAssocTLB::Insert
+// 	Put "entry" in its set, unless it is there already: in an empty
+//	slot if there is one, otherwise in place of the slot the policy
+//	chooses -- the one with the oldest stamp, or a random one.
+//----------------------------------------------------------------------
+
+void
+SetAssocTLB::Insert(TranslationEntry *entry)
+{
+    int first = (entry->virtualPage % numSets) * ways;
+    int pos = -1;
+
+    clock++;
+    for (int i = first; i < first + ways; i++) {
+	if (slots[i] == entry)
+	    return;
+	if (slots[i] == NULL) {
+	    if (pos == -1 || slots[pos] != NULL)
+		pos = i;
+	} else if (pos == -1 || (slots[pos] != NULL && stamp[i] < stamp[pos]))
+	    pos = i;
+    }
+    if (slots[pos] != NULL && policy == TLBReplaceRandom)
+	pos = first + Random() % ways;
+    slots[pos] = entry;
+    stamp[pos] = clock;
+}
+
+//----------------------------------------------------------------------
+// SetAssocTLB::Flush
+// 	Empty the slot holding "entry", if any.
+//----------------------------------------------------------------------
+
+void
+SetAssocTLB::Flush(TranslationEntry *entry)
+{
+    int first = (entry->virtualPage % numSets) * ways;
+
+    for (int i = first; i < first + ways; i++)
+	if (slots[i] == entry)
+	    slots[i] = NULL;
+}
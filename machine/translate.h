@@ -35,7 +35,6 @@ class TranslationEntry {
     int t;
     
     int tid;
-    bool tomb; // for hashing conflict
 
     bool valid;         // If this bit is set, the translation is ignored.
 			// (In other words, the entry hasn't been initialized.)
@@ -45,6 +44,83 @@ class TranslationEntry {
 			// page is referenced or modified.
     bool dirty;         // This bit is set by the hardware every time the
 			// page is modified.
+    bool copyOnWrite;	// Read-only only because the frame is shared
+			// since a fork; a store makes a private copy.
+    bool prefetched;	// Brought in ahead of a fault, and not used yet.
+    bool mappedAhead;	// Put in the TLB by fault-around, and not used
+			// since.
+};
+
+// The inverted page table: one TranslationEntry per resident page,
+// found by hashing its <thread id, virtual page #> into a bucket and
+// following the bucket's chain.  Deleting an entry just unlinks it, so
+// lookups never wade through tombstones, and cost O(1) on average as
+// long as there are about as many buckets as entries.
+//
+// Entries are handed out from a free list, separately from linking
+// them into the table, so the pager can hold on to an entry while it
+// fills the page and only make it visible once the page is ready.
+
+class HashedPageTable {
+  public:
+    HashedPageTable(int entryCount);	// all entries start out free
+    ~HashedPageTable();
+
+    int Lookup(int vpn, int tid);	// index of the entry mapping
+					// <tid, vpn>, or -1
+    int Allocate();			// take a free entry; -1 if none
+    void Link(int idx);			// make an entry findable under its
+					// virtualPage and tid
+    void Unlink(int idx);		// make it unfindable again
+    void Free(int idx);			// return an unlinked entry
+
+    int NumEntries() { return numEntries; }
+
+    TranslationEntry *entries;		// the entries themselves
+
+  private:
+    int Hash(int vpn, int tid);
+
+    int numEntries;
+    int numBuckets;			// a power of 2, >= numEntries
+    int *bucket;			// first entry of each chain, or -1
+    int *next;				// next entry on the same chain (or
+					// on the free list), or -1
+    int freeList;			// first free entry, or -1
+};
+
+// A second level TLB: a set-associative cache of pointers to page table
+// entries, looked up by the hardware when the (fully associative, first
+// level) TLB misses, before trapping to the kernel.  Entries are tagged
+// with the tid of their address space.  The set of a page is its
+// virtual page number modulo the number of sets; within the set, the
+// entry to replace is chosen LRU, FIFO or at random.
+
+enum TLBReplace { TLBReplaceLRU, TLBReplaceFIFO, TLBReplaceRandom };
+
+class SetAssocTLB {
+  public:
+    SetAssocTLB(int numEntries, int ways, TLBReplace policy);
+					// numEntries must be a multiple
+					// of ways
+    ~SetAssocTLB();
+
+    TranslationEntry *Lookup(int vpn, int tid);
+					// the entry mapping <tid, vpn>,
+					// or NULL
+    void Insert(TranslationEntry *entry);
+					// cache "entry", replacing one of
+					// its set if the set is full
+    void Flush(TranslationEntry *entry);
+					// forget "entry"
+
+  private:
+    int numSets, ways;
+    TLBReplace policy;
+    TranslationEntry **slots;		// ways slots per set, set by set
+    unsigned int *stamp;		// per slot: last use (LRU) or
+					// time of insertion (FIFO)
+    unsigned int clock;			// ticks on each lookup and insert
 };
 
 #endif
@@ -0,0 +1,42 @@
+/* cow.c
+ *	Test program for ProcFork: parent and child each write into a
+ *	copy of the same array, and each must see only its own writes.
+ */
+
+#include "syscall.h"
+
+#define N 1024
+
+int data[N];
+
+int
+check(int base)
+{
+    int i;
+
+    for (i = 0; i < N; i++)
+	if (data[i] != base + i)
+	    return 1;
+    return 0;
+}
+
+int
+main()
+{
+    int i, child;
+
+    for (i = 0; i < N; i++)
+	data[i] = i;
+    child = ProcFork();
+    if (child == 0) {
+	for (i = 0; i < N; i++)
+	    data[i] += 10000;
+	Exit(check(10000));
+    }
+    for (i = 0; i < N; i++)
+	data[i] += 20000;
+    i = Join(child);
+    PutInt(check(20000) + i);	/* 0 if neither saw the other's writes */
+    PutChar('\n');
+    Exit(0);
+}
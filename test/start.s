@@ -146,6 +146,14 @@ PutInt:
 	j	$31
 	.end PutInt
 
+	.globl ProcFork
+	.ent ProcFork
+ProcFork:
+	addiu $2,$0,SC_ProcFork
+	syscall
+	j	$31
+	.end ProcFork
+
 /* dummy function to keep gcc happy */
         .globl  __main
         .ent    __main
@@ -242,6 +242,27 @@ List::SortedRemove(int *keyPtr)
     return thing;
 }
 
+//----------------------------------------------------------------------
+// List::SortedPeek
+//      Look at the first "item" of a sorted list without removing it.
+// 
+// Returns:
+//	Pointer to the first item, NULL if nothing on the list.
+//	Sets *keyPtr to its priority value, and *tiedPtr to TRUE if the
+//	next item on the list has the same priority.
+//----------------------------------------------------------------------
+
+void *
+List::SortedPeek(int *keyPtr, bool *tiedPtr)
+{
+    if (IsEmpty())
+	return NULL;
+
+    *keyPtr = first->key;
+    *tiedPtr = (first->next != NULL) && (first->next->key == first->key);
+    return first->item;
+}
+
 
 
 void
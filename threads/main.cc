@@ -9,8 +9,12 @@
 // 	Most of this file is not needed until later assignments.
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
-//		-f -cp <unix file> <nachos file>
+//		-s -bb -jit -pm <frames> -ps <page size> -tlb <entries>
+//		-tlb2 <entries> <ways> <lru|fifo|random> -hw
+//		-vm <lru|clock|wsclock> -po <low> <high>
+//		-x <nachos file> -c <consoleIn> <consoleOut> -ptb
+//		-f -bc <sectors> -fl <index|extent> -sw <sectors>
+//		-cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
 //              -n <network reliability> -m <machine id>
 //              -o <other machine id>
@@ -22,11 +26,34 @@
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -bb runs user programs a basic block at a time instead of
+//	decoding and interpreting one instruction at a time
+//    -jit is like -bb, but also translates frequently run blocks into
+//	traces with their operands resolved in advance
+//    -pm sets the number of physical page frames (default 32)
+//    -ps sets the page size in bytes, a power of 2 and a multiple of
+//	the disk sector size (default one sector)
+//    -tlb sets the number of TLB entries (default 4)
+//    -tlb2 adds a set-associative L2 TLB, which the hardware searches
+//	on a TLB miss before trapping to the kernel
+//    -hw makes the hardware refill the TLB from the inverted page table
+//	on a miss, so only true page faults trap to the kernel
+//    -vm chooses the page replacement policy: exact LRU, CLOCK
+//	(the default) or WSClock
+//    -po sets the free frame counts at which the pageout daemon wakes
+//	up and goes back to sleep (default 1/16 and 1/8 of memory);
+//	-po 0 0 stops it from freeing frames (it still reads ahead)
 //    -x runs a user program
 //    -c tests the console
+//    -ptb times insertion and lookup in the inverted page table
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
+//    -bc sets the number of sectors in the block cache (default 64)
+//    -fl chooses how new files are laid out: in index blocks, or in
+//	extents of contiguous sectors (the default)
+//    -sw sets the number of sectors in the swap area (default 128); the
+//	area is the file /.swap, made again when its size changes
 //    -cp copies a file from UNIX to Nachos
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
@@ -63,6 +90,7 @@ extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
 extern void Print(char *file), PerformanceTest(void);
 extern void SynchTest(int), PipeTest();
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
+extern void PageTableBenchmark();
 extern void MailTest(int networkID);
 
 
@@ -140,6 +168,8 @@ main(int argc, char **argv)
 					// Nachos will loop forever waiting 
 					// for console input
 		}
+        else if (!strcmp(*argv, "-ptb"))	// time the page table
+            PageTableBenchmark();
 #endif // USER_PROGRAM
 #ifdef FILESYS
 	if (!strcmp(*argv, "-cp")) { 		// copy from UNIX to Nachos
@@ -172,6 +202,8 @@ main(int argc, char **argv)
 	} else if (!strcmp(*argv, "-pi")) {
 		PipeTest();
 	}
+	inodeTable->Sync();			// make the changes durable
+	blockCache->Sync();
 #endif // FILESYS
 #ifdef NETWORK
         if (!strcmp(*argv, "-o")) {
@@ -126,17 +126,6 @@ Scheduler::FindNextToRun ()
 //
 //	"nextThread" is the thread to be put into the CPU.
 //----------------------------------------------------------------------
-#ifdef USER_PROGRAM
-void InvalidTLB()
-{
-#ifdef USE_TLB
-    for (int i = 0; i < TLBSize; i++)
-    {
-        machine->tlb[i] = NULL;
-    }
-#endif
-}
-#endif
 
 void
 Scheduler::Run (Thread *nextThread)
@@ -157,9 +146,8 @@ Scheduler::Run (Thread *nextThread)
     currentThread->setStatus(RUNNING);      // nextThread is now running
     lastthread = NULL;
     if(currentThread == oldThread) return;
-#ifdef USER_PROGRAM
-    InvalidTLB();
-#endif
+    stats->numContextSwitches++;	// the TLB is kept: its entries are
+					// tagged with their space's tid
 
     DEBUG('t', "Switching from thread \"%s\" to thread \"%s\"\n",
 	  oldThread->getName(), nextThread->getName());
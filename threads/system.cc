@@ -30,11 +30,17 @@ FileSystem  *fileSystem;
 
 #ifdef FILESYS
 SynchDisk   *synchDisk;
+BlockCache  *blockCache;
+InodeTable  *inodeTable;
 #endif
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
 BitMap* memmap;
+ReplacePolicy *replacePolicy;	// picks pages to replace
+SwapArea *swapArea;		// where pages not in memory are kept
+TextCache *textCache;		// code pages shared between processes
+Pageout *pageout;		// keeps a pool of free frames
 #endif
 
 #ifdef NETWORK
@@ -90,10 +96,16 @@ Initialize(int argc, char **argv)
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    ExecEngine userEngine = InterpEngine; // how to run user instructions
+    char *policyName = "clock";	// page replacement policy
+    int pageoutLow = -1, pageoutHigh = -1; // free frame watermarks
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
 #endif
+#ifdef FILESYS
+    int cacheBlocks = DefaultCacheBlocks; // sectors in the block cache
+#endif
 #ifdef NETWORK
     double rely = 1;		// network reliability
     int netname = 0;		// UNIX socket name
@@ -118,11 +130,75 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	else if (!strcmp(*argv, "-bb"))
+	    userEngine = BlockEngine;
+	else if (!strcmp(*argv, "-jit"))
+	    userEngine = TraceEngine;
+	else if (!strcmp(*argv, "-pm")) {	// frames of physical memory
+	    ASSERT(argc > 1);
+	    NumPhysPages = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-ps")) {	// bytes per page
+	    ASSERT(argc > 1);
+	    PageSize = atoi(*(argv + 1));
+	    for (PageShift = 0; (1 << PageShift) < PageSize; PageShift++)
+		;
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tlb")) {	// TLB entries
+	    ASSERT(argc > 1);
+	    TLBSize = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-hw"))	// hardware page table walks
+	    HardwareWalk = TRUE;
+	else if (!strcmp(*argv, "-tlb2")) {	// L2 TLB entries, ways,
+	    ASSERT(argc > 3);			// replacement policy
+	    TLB2Size = atoi(*(argv + 1));
+	    TLB2Ways = atoi(*(argv + 2));
+	    if (!strcmp(*(argv + 3), "fifo"))
+		TLB2Replace = TLBReplaceFIFO;
+	    else if (!strcmp(*(argv + 3), "random"))
+		TLB2Replace = TLBReplaceRandom;
+	    else {
+		ASSERT(!strcmp(*(argv + 3), "lru"));
+		TLB2Replace = TLBReplaceLRU;
+	    }
+	    argCount = 4;
+	} else if (!strcmp(*argv, "-vm")) {	// page replacement policy
+	    ASSERT(argc > 1);
+	    policyName = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-po")) {	// pageout watermarks
+	    ASSERT(argc > 2);
+	    pageoutLow = atoi(*(argv + 1));
+	    pageoutHigh = atoi(*(argv + 2));
+	    argCount = 3;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
 	    format = TRUE;
 #endif
+#ifdef FILESYS
+	if (!strcmp(*argv, "-bc")) {	// sectors in the block cache
+	    ASSERT(argc > 1);
+	    cacheBlocks = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-fl")) {	// layout of new files
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "index"))
+		ExtentFiles = FALSE;
+	    else {
+		ASSERT(!strcmp(*(argv + 1), "extent"));
+		ExtentFiles = TRUE;
+	    }
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-sw")) {	// sectors in the swap area
+	    ASSERT(argc > 1);
+	    SwapSectors = atoi(*(argv + 1));
+	    ASSERT(SwapSectors > 0 && SwapSectors < NumSectors);
+	    argCount = 2;
+	}
+#endif
 #ifdef NETWORK
 	if (!strcmp(*argv, "-l")) {
 	    ASSERT(argc > 1);
@@ -159,18 +235,33 @@ Initialize(int argc, char **argv)
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
     
 #ifdef USER_PROGRAM
-    machine = new Machine(debugUserProg);	// this must come first
+    machine = new Machine(debugUserProg, userEngine); // this must come first
     memmap = new BitMap(NumPhysPages);
+    textCache = new TextCache(NumPhysPages);
+    replacePolicy = NewReplacePolicy(policyName);
+    ASSERT(replacePolicy != NULL);
+    DEBUG('a', "Page replacement policy: %s\n", replacePolicy->Name());
 #endif
 
 #ifdef FILESYS
     synchDisk = new SynchDisk("DISK");
+    blockCache = new BlockCache(synchDisk, cacheBlocks);
+    inodeTable = new InodeTable;
 #endif
 
 #ifdef FILESYS_NEEDED
     fileSystem = new FileSystem(format);
 #endif
 
+#ifdef USER_PROGRAM
+    swapArea = new SwapArea(synchDisk, FirstSwapSector, SwapSectors);
+    if (pageoutLow < 0) {		// default: 1/16 and 1/8 of memory
+	pageoutLow = NumPhysPages / 16;
+	pageoutHigh = NumPhysPages / 8;
+    }
+    pageout = new Pageout(pageoutLow, pageoutHigh);
+#endif
+
 #ifdef NETWORK
     postOffice = new PostOffice(netname, rely, 10);
 #endif
@@ -191,6 +282,10 @@ Cleanup()
 #ifdef USER_PROGRAM
     delete machine;
     delete memmap;
+    delete replacePolicy;
+    delete swapArea;
+    delete textCache;
+    delete pageout;
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -198,7 +293,9 @@ Cleanup()
 #endif
 
 #ifdef FILESYS
-    delete synchDisk;
+    delete inodeTable;
+    delete blockCache;		// Halt has synced it; on ctl-C, what is
+    delete synchDisk;		// still dirty is lost, as on a crash
 #endif
     
     delete timer;
@@ -43,8 +43,16 @@ extern void TS();
 
 #ifdef USER_PROGRAM
 #include "machine.h"
+#include "replace.h"
+#include "swap.h"
+#include "textcache.h"
+#include "pageout.h"
 extern Machine* machine;	// user program memory and registers
 extern BitMap* memmap;
+extern ReplacePolicy* replacePolicy;	// picks pages to replace
+extern SwapArea* swapArea;	// where pages not in memory are kept
+extern TextCache* textCache;	// code pages shared between processes
+extern Pageout* pageout;	// keeps a pool of free frames
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
@@ -54,7 +62,11 @@ extern FileSystem  *fileSystem;
 
 #ifdef FILESYS
 #include "synchdisk.h"
+#include "blockcache.h"
+#include "inode.h"
 extern SynchDisk   *synchDisk;
+extern BlockCache  *blockCache;		// all file system disk I/O
+extern InodeTable  *inodeTable;		// headers of the open files
 #endif
 
 #ifdef NETWORK
@@ -18,7 +18,6 @@
 #include "copyright.h"
 #include "system.h"
 #include "addrspace.h"
-#include "noff.h"
 #ifdef HOST_SPARC
 #include <strings.h>
 #endif
@@ -27,6 +26,11 @@ static inline int min(int a, int b)
     if(a < b) return a;
     return b;
 }
+static inline int max(int a, int b)
+{
+    if(a > b) return a;
+    return b;
+}
 
 //----------------------------------------------------------------------
 // SwapHeader
@@ -50,6 +54,24 @@ SwapHeader (NoffHeader *noffH)
 	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
 }
 
+//----------------------------------------------------------------------
+// LoadSegment
+// 	Copy the part of segment "seg" that falls in virtual page "vpn"
+//	from the executable into "page", PageSize bytes.
+//----------------------------------------------------------------------
+
+static void
+LoadSegment(OpenFile *executable, Segment *seg, int vpn, char *page)
+{
+    int start = max(seg->virtualAddr, vpn * PageSize),
+        end = min(seg->virtualAddr + seg->size, (vpn + 1) * PageSize);
+
+    if (seg->size <= 0 || start >= end)
+        return;
+    executable->ReadAt(page + start - vpn * PageSize, end - start,
+        seg->inFileAddr + start - seg->virtualAddr);
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::AddrSpace
 // 	Create an address space to run a user program.
@@ -62,15 +84,25 @@ SwapHeader (NoffHeader *noffH)
 //	memory.  For now, this is really simple (1:1), since we are
 //	only uniprogramming, and we have a single unsegmented page table
 //
-//	"executable" is the file containing the object code to load into memory
+//	Nothing is read in yet: each page is loaded from the executable
+//	the first time it is touched (see LoadPage), so the cost of
+//	starting a program does not depend on its size.
+//
+//	"executable" is the file containing the object code to load into
+//	memory; the address space owns it from now on
 //----------------------------------------------------------------------
 
-AddrSpace::AddrSpace(OpenFile *executable)
+AddrSpace::AddrSpace(OpenFile *exec)
 {
     NoffHeader noffH;
-    unsigned int i, size;
+    unsigned int size;
     tid = currentThread->getTID();
     ref = 1;
+    executable = exec;
+    lastFault = nextFault = -1;
+    aheadCount = 0;
+    aroundWindow = 1;
+    aroundMapped = aroundUsed = 0;
 
     executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
     if ((noffH.noffMagic != NOFFMAGIC) && 
@@ -130,83 +162,135 @@ AddrSpace::AddrSpace(OpenFile *executable)
 // and the stack segment
 //    bzero(machine->mainMemory, size);
 
-    char buf[PageSize];
-    char name[32];
-    snprintf(name, 32, "vm_%d", currentThread->getTID());
-    fileSystem->Create(name, size);
-    OpenFile *vm = fileSystem->Open(name);
-    ASSERT(vm);
-// then, copy in the code and data segments into memory
-    if (noffH.code.size > 0) {
-        DEBUG('a', "Initializing code segment, at 0x%x, size %d\n", 
-			noffH.code.virtualAddr, noffH.code.size);
-//        executable->ReadAt(&(machine->mainMemory[noffH.code.virtualAddr]),
-//			noffH.code.size, noffH.code.inFileAddr);
-        int codesize = noffH.code.size,
-            ifaddr = noffH.code.inFileAddr,
-            codevaddr = noffH.code.virtualAddr;
-        while(codesize > 0)
-        {
-            int vpn = codevaddr / PageSize,
-                off = codevaddr % PageSize,
-                idx = machine->find(vpn, tid),
-                pn = machine->InvPageTable[idx].physicalPage,
-                readsize = min(codesize, PageSize-off);
-//            executable->ReadAt(machine->mainMemory + pn*PageSize + off,
-//                readsize, ifaddr);
-            executable->ReadAt(buf + off, readsize, ifaddr);
-            vm->WriteAt(buf + off, PageSize, codevaddr);
-            ifaddr += readsize;
-            codesize -= readsize;
-            codevaddr += readsize;
-        }
-    }
-    if (noffH.initData.size > 0) {
-        DEBUG('a', "Initializing data segment, at 0x%x, size %d\n", 
-			noffH.initData.virtualAddr, noffH.initData.size);
-//       executable->ReadAt(&(machine->mainMemory[noffH.initData.virtualAddr]),
-//			noffH.initData.size, noffH.initData.inFileAddr);
-        int datasize = noffH.initData.size,
-            ifaddr = noffH.initData.inFileAddr,
-            datavaddr = noffH.initData.virtualAddr;
-        while(datasize > 0)
-        {
-            int vpn = datavaddr / PageSize,
-                off = datavaddr % PageSize,
-                idx = machine->find(vpn, tid),
-                pn = machine->InvPageTable[idx].physicalPage,
-                readsize = min(datasize, PageSize-off);
-//            executable->ReadAt(machine->mainMemory + pn*PageSize + off,
-//                readsize, ifaddr);
-            executable->ReadAt(buf + off, readsize, ifaddr);
-            vm->WriteAt(buf + off, PageSize, datavaddr);
-            ifaddr += readsize;
-            datasize -= readsize;
-            datavaddr += readsize;
-        }
-    }
-    delete vm;
+// pages get a slot in the swap area only once they are written there
+    swapArea->AddSpace(tid, numPages);
+    code = noffH.code;
+    initData = noffH.initData;
+    DEBUG('a', "Code segment at 0x%x, size %d; data at 0x%x, size %d\n", 
+	code.virtualAddr, code.size, initData.virtualAddr, initData.size);
+}
 
+//----------------------------------------------------------------------
+// AddrSpace::AddrSpace
+// 	Create the address space of a process forked from "parent".  It
+//	starts out with the same contents: it opens the same executable,
+//	and shares the parent's slots in the swap area until one of them
+//	writes the page out again.  The caller shares the pages in memory.
+//
+//	"childTid" -- the thread that will run in the new space
+//----------------------------------------------------------------------
+
+AddrSpace::AddrSpace(AddrSpace *parent, int childTid)
+{
+    tid = childTid;
+    ref = 1;
+    lastFault = nextFault = -1;
+    aheadCount = 0;
+    aroundWindow = parent->aroundWindow;
+    aroundMapped = aroundUsed = 0;
+    numPages = parent->numPages;
+    executable = new OpenFile(parent->executable->HeaderSector());
+    code = parent->code;
+    initData = parent->initData;
+    swapArea->ForkSpace(parent->tid, tid);
 }
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.  Nothing for now!
+// 	Dealloate an address space: give up the frames and page table
+//	entries of its pages, its slots in the swap area, and the
+//	executable.  The pageout daemon must first stop reading ahead
+//	for it.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
+    pageout->Forget(this);		// no read ahead into it any more
     for(int i = 0; i < numPages; i++)
     {
         int idx = machine->find(i, tid);
         if(idx >= NumPhysPages) continue;
-        machine->InvPageTable[idx].valid = FALSE;
-        machine->InvPageTable[idx].tomb = TRUE;
-        memmap->Clear(machine->InvPageTable[idx].physicalPage);
+        int pn = machine->InvPageTable[idx].physicalPage;
+        if(--machine->frameRefs[pn] == 0 && !textCache->Keep(pn))
+        {				// not shared, nor cached code
+            memmap->Clear(pn);
+            machine->InvalidateFrame(pn);
+        }
+        machine->remove(idx);
     }
+    machine->InvalidateTranslations();
+    swapArea->RemoveSpace(tid);
+    delete executable;
 //    delete pageTable;
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::IsText
+// 	Return TRUE if virtual page "vpn" lies wholly inside the code
+//	segment, so that it can be shared read-only with other processes
+//	running the same executable (see TextCache).
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::IsText(int vpn)
+{
+    int start = vpn * PageSize;
+
+    return code.size > 0 && start >= code.virtualAddr
+        && start + PageSize <= code.virtualAddr + code.size;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::IsZeroFill
+// 	Return TRUE if virtual page "vpn" has never been written out and
+//	the executable has nothing for it -- a page of the uninitialized
+//	data or the stack that is still all zeroes, as far as the disk
+//	is concerned.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::IsZeroFill(int vpn)
+{
+    int start = vpn * PageSize, end = start + PageSize;
+
+    if (swapArea->HasSlot(tid, vpn))
+        return FALSE;
+    if (code.size > 0 && code.virtualAddr < end
+            && start < code.virtualAddr + code.size)
+        return FALSE;
+    if (initData.size > 0 && initData.virtualAddr < end
+            && start < initData.virtualAddr + initData.size)
+        return FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::LoadPage
+// 	Fill "into" (PageSize bytes) with the contents of virtual page
+//	"vpn".  A page that has been written to the swap area comes from
+//	there; any other page still holds what the executable says --
+//	the code and initialized data it covers, and zeroes elsewhere.
+//	A page with nothing in the executable is just cleared, without
+//	touching the disk.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::LoadPage(int vpn, char *into)
+{
+    ASSERT(vpn >= 0 && (unsigned) vpn < numPages);
+    if (IsZeroFill(vpn)) {
+        DEBUG('a', "Zero-filling page %d of space %d\n", vpn, tid);
+        stats->numZeroFills++;
+        bzero(into, PageSize);
+    } else if (swapArea->HasSlot(tid, vpn)) {
+        swapArea->ReadPage(tid, vpn, into);
+    } else {
+        bzero(into, PageSize);
+        LoadSegment(executable, &code, vpn, into);
+        LoadSegment(executable, &initData, vpn, into);
+    }
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::InitRegisters
 // 	Set the initial values for the user-level register set.
@@ -262,4 +346,5 @@ void AddrSpace::RestoreState()
 {
 //    machine->pageTable = pageTable;
     machine->pageTableSize = numPages;
+    machine->InvalidateTranslations();
 }
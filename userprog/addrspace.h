@@ -15,6 +15,7 @@
 
 #include "copyright.h"
 #include "filesys.h"
+#include "noff.h"
 
 #define UserStackSize		1024 	// increase this as necessary!
 
@@ -22,22 +23,48 @@ class AddrSpace {
   public:
     AddrSpace(OpenFile *executable);	// Create an address space,
 					// initializing it with the program
-					// stored in the file "executable"
+					// stored in the file "executable";
+					// the space keeps the file open
+    AddrSpace(AddrSpace *parent, int childTid);
+					// Create a copy of "parent" for a
+					// forked process, sharing its pages
+					// (see ForkPages in exception.cc)
     ~AddrSpace();			// De-allocate an address space
 
+    void LoadPage(int vpn, char *into);	// Fetch the contents of a page
+					// that is not in memory
+    bool IsZeroFill(int vpn);		// Is the page bss or stack that
+					// has never been written out?
+    bool IsText(int vpn);		// Is the page pure code?
+    int TextFile() { return executable->HeaderSector(); }
+					// Names the executable in textCache
+
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
 
     void SaveState();			// Save/restore address space-specific
     void RestoreState();		// info on a context switch
+    int NumPages() { return numPages; }
     int tid;
     int ref;
 
+    int lastFault, nextFault;		// the last page fault, and the
+					// furthest page a sequential scan
+					// may fault on next (see Prefetch)
+    int aheadFirst, aheadCount;		// read-ahead request waiting for
+					// the pageout daemon; count 0 if none
+    int aroundWindow;			// how many neighbours of a TLB miss
+					// fault-around maps (see FaultAround)
+    int aroundMapped, aroundUsed;	// how many it mapped lately, and
+					// how many of those got used
+
   private:
 //    TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    OpenFile *executable;		// where pages never written to swap
+    Segment code, initData;		// come from
 
 };
 
@@ -22,8 +22,10 @@ BitMap::BitMap(int nitems)
     numBits = nitems;
     numWords = divRoundUp(numBits, BitsInWord);
     map = new unsigned int[numWords];
-    for (int i = 0; i < numBits; i++) 
-        Clear(i);
+    summary = new unsigned int[divRoundUp(numWords, BitsInWord)];
+    for (int i = 0; i < numWords; i++) 
+        map[i] = 0;
+    Recount();
 }
 
 //----------------------------------------------------------------------
@@ -33,7 +35,8 @@ BitMap::BitMap(int nitems)
 
 BitMap::~BitMap()
 { 
-    delete map;
+    delete [] map;
+    delete [] summary;
 }
 
 //----------------------------------------------------------------------
@@ -47,7 +50,15 @@ void
 BitMap::Mark(int which) 
 { 
     ASSERT(which >= 0 && which < numBits);
-    map[which / BitsInWord] |= 1 << (which % BitsInWord);
+    int w = which / BitsInWord;
+    unsigned int bit = 1u << (which % BitsInWord);
+
+    if (map[w] & bit)
+	return;
+    map[w] |= bit;
+    numClear--;
+    if (map[w] == ~0u)
+	summary[w / BitsInWord] &= ~(1u << (w % BitsInWord));
 }
     
 //----------------------------------------------------------------------
@@ -61,7 +72,14 @@ void
 BitMap::Clear(int which) 
 {
     ASSERT(which >= 0 && which < numBits);
-    map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    int w = which / BitsInWord;
+    unsigned int bit = 1u << (which % BitsInWord);
+
+    if (!(map[w] & bit))
+	return;
+    map[w] &= ~bit;
+    numClear++;
+    summary[w / BitsInWord] |= 1u << (w % BitsInWord);
 }
 
 //----------------------------------------------------------------------
@@ -76,7 +94,7 @@ BitMap::Test(int which)
 {
     ASSERT(which >= 0 && which < numBits);
     
-    if (map[which / BitsInWord] & (1 << (which % BitsInWord)))
+    if (map[which / BitsInWord] & (1u << (which % BitsInWord)))
 	return TRUE;
     else
 	return FALSE;
@@ -94,12 +112,11 @@ BitMap::Test(int which)
 int 
 BitMap::Find() 
 {
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) {
-	    Mark(i);
-	    return i;
-	}
-    return -1;
+    int i = NextClear(0);
+
+    if (i != -1)
+	Mark(i);
+    return i;
 }
 
 //----------------------------------------------------------------------
@@ -111,11 +128,122 @@ BitMap::Find()
 int 
 BitMap::NumClear() 
 {
-    int count = 0;
+    return numClear;
+}
 
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) count++;
-    return count;
+//----------------------------------------------------------------------
+// BitMap::FindRun
+// 	Look for a run of "count" clear bits, searching from bit "near"
+//	and wrapping around at the end.  If there is no run that long,
+//	settle for the longest one there is.  No bit is set.
+//
+//	Return the first bit of the run, and its length (at most "count")
+//	in "*length"; or -1 if no bit is clear.
+//----------------------------------------------------------------------
+
+int
+BitMap::FindRun(int count, int near, int *length)
+{
+    int best = -1, bestLength = 0;
+    bool wrapped = FALSE;
+    int i = NextClear(near);
+
+    for (;;) {
+	if (i == -1 || (wrapped && i >= near)) {
+	    if (wrapped || near == 0)
+		break;
+	    wrapped = TRUE;		// search the bits before "near"
+	    i = NextClear(0);
+	    continue;
+	}
+	int limit = (count < numBits - i) ? i + count : numBits;
+	int end = NextSet(i, limit);
+
+	if (end - i > bestLength) {
+	    best = i;
+	    bestLength = end - i;
+	    if (bestLength == count)
+		break;
+	}
+	i = (end < numBits) ? NextClear(end) : -1;
+    }
+    *length = bestLength;
+    return best;
+}
+
+//----------------------------------------------------------------------
+// BitMap::NextClear
+// 	Return the first clear bit at or after "from", or -1 if there is
+//	none: the rest of its word is checked, then the summary is used to
+//	jump to the next word with a clear bit.
+//----------------------------------------------------------------------
+
+int
+BitMap::NextClear(int from)
+{
+    if (from >= numBits)
+	return -1;
+
+    int w = from / BitsInWord;
+    unsigned int bits = ~map[w] & (~0u << (from % BitsInWord));
+
+    if (bits)
+	return w * BitsInWord + __builtin_ctz(bits);
+    for (w++; w < numWords; ) {
+	int s = w / BitsInWord;
+	unsigned int words = summary[s] & (~0u << (w % BitsInWord));
+
+	if (words) {
+	    w = s * BitsInWord + __builtin_ctz(words);
+	    return w * BitsInWord + __builtin_ctz(~map[w]);
+	}
+	w = (s + 1) * BitsInWord;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// BitMap::NextSet
+// 	Return the first set bit in [from, limit), or "limit" if they are
+//	all clear.
+//----------------------------------------------------------------------
+
+int
+BitMap::NextSet(int from, int limit)
+{
+    while (from < limit) {
+	int w = from / BitsInWord;
+	unsigned int bits = map[w] & (~0u << (from % BitsInWord));
+
+	if (bits) {
+	    int i = w * BitsInWord + __builtin_ctz(bits);
+	    return (i < limit) ? i : limit;
+	}
+	from = (w + 1) * BitsInWord;
+    }
+    return limit;
+}
+
+//----------------------------------------------------------------------
+// BitMap::Recount
+// 	Set the bits past the end, which no search must find, and
+//	recompute the number of clear bits and the summary after the
+//	whole map has changed.
+//----------------------------------------------------------------------
+
+void
+BitMap::Recount()
+{
+    if (numBits % BitsInWord != 0)
+	map[numWords - 1] |= ~0u << (numBits % BitsInWord);
+    for (int s = 0; s < divRoundUp(numWords, BitsInWord); s++)
+	summary[s] = 0;
+    numClear = 0;
+    for (int w = 0; w < numWords; w++)
+	if (map[w] != ~0u) {
+	    numClear += __builtin_popcount(~map[w]);
+	    summary[w / BitsInWord] |= 1u << (w % BitsInWord);
+	}
 }
 
 //----------------------------------------------------------------------
@@ -149,6 +277,7 @@ void
 BitMap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    Recount();
 }
 
 //----------------------------------------------------------------------
@@ -5,6 +5,12 @@
 //	Represented as an array of unsigned integers, on which we do
 //	modulo arithmetic to find the bit we are interested in.
 //
+//	Searches go a word at a time, and a summary with one bit per word
+//	-- set if the word has a clear bit -- lets them skip over full
+//	words 32 at a time.  On the disk's free map a word is exactly one
+//	track, so the summary tells which tracks have free sectors.  The
+//	number of clear bits is kept up to date, so NumClear costs nothing.
+//
 //	The bitmap can be parameterized with with the number of bits being 
 //	managed.
 //
@@ -44,6 +50,9 @@ class BitMap {
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
     int NumClear();		// Return the number of clear bits
+    int FindRun(int count, int near, int *length);
+				// Find "count" clear bits in a row, or
+				// the longest run there is; sets nothing
 
     void Print();		// Print contents of bitmap
     
@@ -53,12 +62,21 @@ class BitMap {
     void WriteBack(OpenFile *file); 	// write contents to disk
 
   private:
+    void Recount();			// Recompute numClear and the summary
+    int NextClear(int from);		// First clear bit at or after
+					// "from", or -1
+    int NextSet(int from, int limit);	// First set bit in [from, limit),
+					// or "limit"
+
     int numBits;			// number of bits in the bitmap
     int numWords;			// number of words of bitmap storage
 					// (rounded up if numBits is not a
 					//  multiple of the number of bits in
 					//  a word)
-    unsigned int *map;			// bit storage
+    unsigned int *map;			// bit storage; the bits past
+					// numBits are kept set
+    unsigned int *summary;		// per word, set if it has a clear bit
+    int numClear;			// number of clear bits
 };
 
 #endif // BITMAP_H
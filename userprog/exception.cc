@@ -27,59 +27,469 @@
 #include "openfile.h"
 extern void StartProcess(char*);
 
-int SwapPage(unsigned int vpn, int tid)
+#define IOWindowPages	8	// user pages pinned at a time by Read/Write
+#define PrefetchPages	4	// pages read ahead of a sequential scan
+#define AroundSample	16	// fault-around entries between adjustments
+				// of its window
+
+//----------------------------------------------------------------------
+// PinUserBuffer
+// 	Fault in and pin the frames behind (up to IOWindowPages pages of)
+//	a user buffer, and describe them as spans so the file system can
+//	move data straight between the block cache and the user's memory.
+//	While pinned, SwapPage will not take the frames away, even if the
+//	transfer blocks and other threads fault.
+//
+//	Returns the number of spans (0 if the address is bad), and sets
+//	*bytes to how much of the buffer they cover.
+//
+//	"writing" -- TRUE if the kernel will store into the buffer
+//----------------------------------------------------------------------
+
+static int
+PinUserBuffer(int addr, int len, bool writing, IOSpan *spans, int *bytes)
 {
-	char buf[32];
-	TranslationEntry *entry = machine->InvPageTable;
-	unsigned idx = machine->addrhash(vpn),
-			 j = machine->rehash(tid),
-			 pos = idx;
-	int i = 0;
-	do
+	int n = 0, count;
+	char *host;
+
+	*bytes = 0;
+	while(n < IOWindowPages && *bytes < len)
 	{
-		if(!entry[idx].valid)
-		{
-			pos = idx;
+		host = machine->UserBytes(addr + *bytes, len - *bytes, writing, &count);
+		if(host == NULL) break;
+		machine->pinCount[(host - machine->mainMemory) / PageSize]++;
+		spans[n].addr = host;
+		spans[n].len = count;
+		*bytes += count;
+		n++;
+	}
+	return n;
+}
+
+//----------------------------------------------------------------------
+// UnpinUserBuffer
+// 	Release the frames pinned by PinUserBuffer.  If the kernel stored
+//	into them, forget any instructions decoded from them.
+//----------------------------------------------------------------------
+
+static void
+UnpinUserBuffer(IOSpan *spans, int n, bool written)
+{
+	for(int i = 0; i < n; i++)
+	{
+		int frame = (spans[i].addr - machine->mainMemory) / PageSize;
+		machine->pinCount[frame]--;
+		if(written)
+			machine->InvalidateFrame(frame);
+	}
+}
+
+//----------------------------------------------------------------------
+// EvictEntry
+// 	Take page table entry "pos" out of use: unlink it, write its page
+//	back to the owner's slot in the swap area if dirty, release the
+//	frame unless the entries of other address spaces still map it
+//	(after a fork) or it is a code page textCache keeps, and put the
+//	entry back on the free list.  Used by faulting threads and by the
+//	pageout daemon.
+//----------------------------------------------------------------------
+
+void
+EvictEntry(int pos)
+{
+	TranslationEntry *entry = &machine->InvPageTable[pos];
+	int pn = entry->physicalPage;
+
+	stats->pageSwaps++;
+	machine->pageHash->Unlink(pos);
+	entry->valid = FALSE;
+	machine->FlushTLBEntry(entry);
+	machine->InvalidateTranslations();
+	if(entry->dirty)
+		swapArea->WritePage(entry->tid, entry->virtualPage,
+			machine->mainMemory + pn*PageSize);
+	if(--machine->frameRefs[pn] == 0 && !textCache->Keep(pn))
+		memmap->Clear(pn);
+	machine->pageHash->Free(pos);
+}
+
+//----------------------------------------------------------------------
+// EvictVictim
+// 	Evict the page replacePolicy chooses, on behalf of a faulting
+//	thread: the pageout daemon has not kept up.
+//----------------------------------------------------------------------
+
+static void
+EvictVictim()
+{
+	int victim = replacePolicy->Victim(machine->pageHash);
+
+	ASSERT(victim != -1);
+	stats->numSyncEvictions++;
+	EvictEntry(victim);
+}
+
+//----------------------------------------------------------------------
+// NewFrame
+// 	Return a free frame.  If there is none, take back a code page that
+//	textCache keeps but no process maps, or failing that, evict the
+//	pages replacePolicy chooses until a frame is free.  The caller
+//	must set its frameRefs.
+//
+//	Wakes the pageout daemon if free frames are running low.
+//----------------------------------------------------------------------
+
+static int
+NewFrame()
+{
+	int pn;
+
+	while((pn = memmap->Find()) == -1)
+	{
+		if((pn = textCache->Reclaim()) != -1)
 			break;
-		}
-		else if(entry[idx].t < entry[pos].t)
+		EvictVictim();
+	}
+	pageout->Check();
+	return pn;
+}
+
+//----------------------------------------------------------------------
+// SwapPage
+// 	Bring virtual page "vpn" of address space "space" into memory.  Use
+//	a free page table entry and frame if there are some; otherwise
+//	evict the pages chosen by replacePolicy until there are.
+//
+//	Pages of the code segment are mapped read-only, from the frame in
+//	textCache if another process running the same program has the page
+//	in memory, and otherwise loaded into a frame put in textCache.
+//
+//	The new entry is only linked into the page table once the page is
+//	ready.
+//
+//	Returns the index of the entry now mapping the page.
+//
+//	"prefetch" -- the page is not wanted yet (see Prefetch): only use
+//		a free entry and a frame above the pageout daemon's low
+//		watermark, and return -1 if there are none
+//----------------------------------------------------------------------
+
+int SwapPage(unsigned int vpn, AddrSpace *space, bool prefetch = FALSE)
+{
+	int tid = space->tid;
+	HashedPageTable *table = machine->pageHash;
+	TranslationEntry *entry = machine->InvPageTable;
+	int pos, pn, i;
+	bool text;
+
+	if(!prefetch)
+		stats->numPageFaults++;
+	while((pos = table->Allocate()) == -1)
+	{
+		if(prefetch)
+			return -1;
+		EvictVictim();
+	}
+	text = space->IsText(vpn);
+	pn = text ? textCache->Lookup(space->TextFile(), vpn) : -1;
+	if(pn != -1)
+		stats->numTextShares++;	// another process has it already
+	else if(prefetch && !pageout->Spare())
+	{
+		table->Free(pos);
+		return -1;
+	}
+	else
+	{
+		pn = NewFrame();
+		space->LoadPage(vpn, machine->mainMemory + pn*PageSize);
+		machine->InvalidateFrame(pn);
+		if(text)
 		{
-			pos = idx;
+			int cached = textCache->Lookup(space->TextFile(), vpn);
+			if(cached != -1)
+			{		// loaded by another process meanwhile
+				memmap->Clear(pn);
+				pn = cached;
+			}
+			else
+				textCache->Insert(space->TextFile(), vpn, pn);
 		}
-		idx += j;
-		idx %= NumPhysPages;
-		i++;
-	}while(i < NumPhysPages);
-	if(!entry[pos].valid)
-	{
-		entry[pos].physicalPage = memmap->Find();
 	}
-	int pn = entry[pos].physicalPage;
-	if(entry[pos].valid && entry[pos].dirty)
+
+	// another thread of the same space may have brought the page in
+	// while we were waiting for the disk
+	i = machine->find(vpn, tid);
+	if(i < NumPhysPages)
 	{
-		int ttid = entry[pos].tid;
-		snprintf(buf, 32, "vm_%d", ttid);
-		OpenFile *out = fileSystem->Open(buf);
-		ASSERT(out);
-		out->WriteAt(machine->mainMemory + pn*PageSize,
-			PageSize, entry[pos].virtualPage*PageSize);
-		delete out;
+		if(machine->frameRefs[pn] == 0 && !textCache->Keep(pn))
+			memmap->Clear(pn);
+		table->Free(pos);
+		return i;
 	}
-	snprintf(buf, 32, "vm_%d", tid);
-	OpenFile *in = fileSystem->Open(buf);
-	ASSERT(in);
-	in->ReadAt(machine->mainMemory + pn*PageSize,
-		PageSize, vpn*PageSize);
-	delete in;
 	entry[pos].tid = tid;
 	entry[pos].virtualPage = vpn;
+	entry[pos].physicalPage = pn;
 	entry[pos].t = stats->totalTicks;
-	entry[pos].tomb = entry[pos].dirty = entry[pos].readOnly =
-	entry[pos].use = FALSE;
+	entry[pos].dirty = entry[pos].use = FALSE;
+	entry[pos].readOnly = text;
+	entry[pos].copyOnWrite = FALSE;
+	entry[pos].prefetched = prefetch;
+	entry[pos].mappedAhead = FALSE;
 	entry[pos].valid = TRUE;
-	stats->pageSwaps++;
+	machine->frameRefs[pn]++;
+	table->Link(pos);
+	machine->InvalidateTranslations();
+	if(prefetch)
+		stats->numPrefetches++;
 	return pos;
 }
+
+//----------------------------------------------------------------------
+// Prefetch
+// 	Called once the page fault on "vpn" has been served.  If the
+//	faults of "space" are walking through its pages in order, have the
+//	pageout daemon bring in the next PrefetchPages pages too, so that
+//	the scan does not fault on every one of them.  The faulting thread
+//	does not wait for those reads: they overlap with its computing.
+//	Prefetching only uses free frames, and never enough to wake the
+//	pageout daemon's refill; it never evicts a page that may still be
+//	wanted.
+//
+//	A fault counts as sequential if it is past the last one, but not
+//	past the end of what was last asked to be read ahead: the daemon
+//	may not have got that far yet.
+//----------------------------------------------------------------------
+
+static void
+Prefetch(int vpn, AddrSpace *space)
+{
+	if(vpn > space->lastFault && vpn <= space->nextFault)
+	{
+		pageout->ReadAhead(space, vpn + 1, PrefetchPages);
+		space->nextFault = vpn + PrefetchPages + 1;
+	}
+	else
+		space->nextFault = vpn + 1;
+	space->lastFault = vpn;
+}
+
+//----------------------------------------------------------------------
+// LoadTLB
+// 	Put page table entry "e" in the TLB, in the slot Machine::TLBVictim
+//	chooses, and in the L2 TLB if there is one.
+//
+//	Returns FALSE if "e" was in the TLB already.
+//
+//	"ahead" -- the entry is loaded by FaultAround, not for a miss;
+//		it is not worth a place in the L2 TLB yet
+//----------------------------------------------------------------------
+
+static bool
+LoadTLB(TranslationEntry *e, bool ahead)
+{
+	for(int i = 0; i < TLBSize; i++)
+		if(machine->tlb[i] == e)
+		{
+			if(!ahead)
+				e->mappedAhead = FALSE;
+			e->t = stats->totalTicks;
+			return FALSE;
+		}
+	machine->FillTLB(machine->TLBVictim(), e);
+	if(!ahead && machine->tlb2 != NULL)
+		machine->tlb2->Insert(e);
+	e->mappedAhead = ahead;
+	e->t = stats->totalTicks;
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FaultAround
+// 	On a TLB miss on "vpn", load the TLB with the resident neighbours
+//	of "vpn" too -- nearest first, up to space->aroundWindow of them --
+//	on the bet that the program touches them soon.  The caller loads
+//	the entry that missed afterwards, so that it is not replaced.
+//
+//	Every AroundSample entries loaded this way, the window grows by
+//	one if more than half of them got used, and shrinks by one if less
+//	than a quarter did.  It stays between 1 and TLBSize - 1.
+//----------------------------------------------------------------------
+
+static void
+FaultAround(int vpn, AddrSpace *space)
+{
+	int mapped = 0, idx, p;
+
+	if(TLBSize < 2)
+		return;			// no room for a neighbour
+	if(space->aroundMapped >= AroundSample)
+	{
+		if(space->aroundUsed * 2 > space->aroundMapped)
+			space->aroundWindow++;
+		else if(space->aroundUsed * 4 < space->aroundMapped)
+			space->aroundWindow--;
+		if(space->aroundWindow < 1)
+			space->aroundWindow = 1;
+		else if(space->aroundWindow > TLBSize - 1)
+			space->aroundWindow = TLBSize - 1;
+		space->aroundMapped = space->aroundUsed = 0;
+	}
+	for(int d = 1; d <= space->aroundWindow && mapped < space->aroundWindow;
+		d++)
+		for(int side = 0; side < 2 && mapped < space->aroundWindow; side++)
+		{
+			p = side ? vpn - d : vpn + d;
+			if(p < 0 || p >= space->NumPages())
+				continue;
+			idx = machine->find(p, space->tid);
+			if(idx < NumPhysPages
+				&& LoadTLB(&machine->InvPageTable[idx], TRUE))
+			{
+				mapped++;
+				space->aroundMapped++;
+				stats->numFaultArounds++;
+			}
+		}
+}
+
+//----------------------------------------------------------------------
+// ForkPages
+// 	Let the address space "child", just forked from "parent", share
+//	the pages "parent" has in memory.  Both now map each such frame
+//	read-only and copy-on-write, so the first of them to store into
+//	the page gets a copy of its own (see CopyOnWrite).  Pages that are
+//	not in memory are shared through the swap area already.
+//
+//	Sharing needs a page table entry for the child.  When there is no
+//	free one, the child gets the page in the swap area instead: a
+//	dirty page is written out to a slot of its own, while a clean one
+//	is already where the child will look for it.  The dirty pages are
+//	copied into kernel buffers before anything waits, and written out
+//	from there: the parent may run and store into its pages while the
+//	writes are under way, but the child gets them as they were at
+//	the fork.
+//----------------------------------------------------------------------
+
+static void
+ForkPages(AddrSpace *parent, AddrSpace *child)
+{
+	HashedPageTable *table = machine->pageHash;
+	TranslationEntry *entry = machine->InvPageTable;
+	int numPages = parent->NumPages();
+	int *copyOut = new int[numPages];
+	char **copies = new char *[numPages];
+	int numCopyOut = 0;
+	int vpn, idx, pos;
+
+	// nothing in this loop waits, so no other thread can run
+	for(vpn = 0; vpn < numPages; vpn++)
+	{
+		idx = machine->find(vpn, parent->tid);
+		if(idx >= NumPhysPages) continue;
+		if((pos = table->Allocate()) == -1)
+		{
+			if(entry[idx].dirty)
+			{
+				copies[numCopyOut] = new char[PageSize];
+				memcpy(copies[numCopyOut], machine->mainMemory
+					+ entry[idx].physicalPage*PageSize, PageSize);
+				copyOut[numCopyOut++] = vpn;
+			}
+			continue;
+		}
+		if(!entry[idx].readOnly)
+		{
+			entry[idx].readOnly = TRUE;
+			entry[idx].copyOnWrite = TRUE;
+		}
+		entry[pos] = entry[idx];
+		entry[pos].tid = child->tid;
+		entry[pos].use = FALSE;
+		entry[pos].prefetched = entry[pos].mappedAhead = FALSE;
+		entry[pos].t = stats->totalTicks;
+		machine->frameRefs[entry[pos].physicalPage]++;
+		table->Link(pos);
+	}
+	machine->InvalidateTranslations();
+
+	for(int i = 0; i < numCopyOut; i++)
+	{
+		swapArea->WritePage(child->tid, copyOut[i], copies[i]);
+		delete [] copies[i];
+	}
+	delete [] copies;
+	delete [] copyOut;
+}
+
+//----------------------------------------------------------------------
+// CopyOnWrite
+// 	Give address space "space" a writable page "vpn", which it has
+//	shared copy-on-write since a fork.  If other spaces still map the
+//	frame, copy it to a frame of our own; if not, the page is ours
+//	alone, and just becomes writable again.
+//
+//	Returns FALSE if the page is not copy-on-write: the program really
+//	tried to store into a read-only page.
+//----------------------------------------------------------------------
+
+static bool
+CopyOnWrite(int vpn, AddrSpace *space)
+{
+	TranslationEntry *entry = machine->InvPageTable;
+	int idx = machine->find(vpn, space->tid);
+	int old, pn;
+
+	if(idx >= NumPhysPages || !entry[idx].copyOnWrite)
+		return FALSE;
+	old = entry[idx].physicalPage;
+	if(machine->frameRefs[old] > 1)
+	{
+		machine->pinCount[old]++;	// keep the original while we
+		pn = NewFrame();		// wait for a frame
+		machine->pinCount[old]--;
+
+		// in the meantime, the other spaces may have given up the
+		// frame, or another thread of ours made the copy
+		idx = machine->find(vpn, space->tid);
+		ASSERT(idx < NumPhysPages);
+		if(entry[idx].copyOnWrite && machine->frameRefs[old] > 1)
+		{
+			bcopy(machine->mainMemory + old*PageSize,
+				machine->mainMemory + pn*PageSize, PageSize);
+			machine->InvalidateFrame(pn);
+			machine->frameRefs[old]--;
+			machine->frameRefs[pn] = 1;
+			entry[idx].physicalPage = pn;
+			stats->numCopyOnWrites++;
+		}
+		else
+			memmap->Clear(pn);
+	}
+	entry[idx].readOnly = FALSE;
+	entry[idx].copyOnWrite = FALSE;
+	machine->InvalidateTranslations();
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// ForkedProcess
+// 	Start running the child of a ProcFork system call, from the user
+//	registers its parent had, which "regs" points to.
+//----------------------------------------------------------------------
+
+static void
+ForkedProcess(int regs)
+{
+	int *r = (int *)regs;
+
+	for(int i = 0; i < NumTotalRegs; i++)
+		machine->WriteRegister(i, r[i]);
+	delete [] r;
+	currentThread->space->RestoreState();
+	machine->Run();
+	ASSERT(FALSE);
+}
 //----------------------------------------------------------------------
 // ExceptionHandler
 // 	Entry point into the Nachos kernel.  Called when a user program
@@ -193,6 +603,36 @@ ExceptionHandler(ExceptionType which)
 			break;
 			}
 
+			case SC_ProcFork:
+			{
+			Thread *t = new Thread("procfork", currentThread->getPriority());
+			AddrSpace *space = new AddrSpace(currentThread->space,
+				t->getTID());
+			t->space = space;
+			ForkPages(currentThread->space, space);
+			for(std::set<int>::iterator i = currentThread->fds.begin();
+				i != currentThread->fds.end();
+				++i)
+			{
+				machine->fd_table[*i].cnt++;
+				t->fds.insert(*i);
+			}
+
+			// the child resumes after the system call, seeing 0
+			int *regs = new int[NumTotalRegs];
+			for(int i = 0; i < NumTotalRegs; i++)
+				regs[i] = machine->ReadRegister(i);
+			regs[PrevPCReg] = regs[PCReg];
+			regs[PCReg] = regs[NextPCReg];
+			regs[NextPCReg] += 4;
+			regs[2] = 0;
+
+			machine->WriteRegister(2, t->getTID());
+			waitforreap[t->getTID()] = true;
+			t->Fork(ForkedProcess, (void*)regs);
+			break;
+			}
+
 			case SC_Create:
 			{
 			DEBUG('a', "syscall: create\n");
@@ -243,13 +683,20 @@ ExceptionHandler(ExceptionType which)
 			int bufaddr = machine->ReadRegister(4);
 			int size = machine->ReadRegister(5);
 			int fd = machine->ReadRegister(6);
-			char *buffer = new char[size];
-			machine->ReadMemArr(bufaddr, size, buffer);
+			IOSpan spans[IOWindowPages];
 			ASSERT(fd >= 0 && fd < NumFD);
 			OpenFile *f = machine->fd_table[fd].file;
 			ASSERT(f);
-			f->Write(buffer, size);
-			delete[] buffer;
+			for(int done = 0; done < size; )
+			{
+				int bytes;
+				int n = PinUserBuffer(bufaddr + done, size - done, FALSE,
+					spans, &bytes);
+				if(n == 0) break;
+				f->WriteV(spans, n);
+				UnpinUserBuffer(spans, n, FALSE);
+				done += bytes;
+			}
 			break;
 			}
 
@@ -259,14 +706,23 @@ ExceptionHandler(ExceptionType which)
 			int bufaddr = machine->ReadRegister(4);
 			int size = machine->ReadRegister(5);
 			int fd = machine->ReadRegister(6);
-			char *buffer = new char[size];
+			IOSpan spans[IOWindowPages];
 			ASSERT(fd >= 0 && fd < NumFD);
 			OpenFile *f = machine->fd_table[fd].file;
 			ASSERT(f);
-			int res = f->Read(buffer, size);
+			int res = 0;
+			while(res < size)
+			{
+				int bytes;
+				int n = PinUserBuffer(bufaddr + res, size - res, TRUE,
+					spans, &bytes);
+				if(n == 0) break;
+				int got = f->ReadV(spans, n);
+				UnpinUserBuffer(spans, n, TRUE);
+				res += got;
+				if(got < bytes) break;
+			}
 			machine->WriteRegister(2, res);
-			machine->WriteMemArr(bufaddr, res, buffer);
-			delete[] buffer;
 			break;
 			}
 
@@ -311,12 +767,14 @@ ExceptionHandler(ExceptionType which)
     	//printf("page fault at virtual address %x\n" ,addr);
 		if(machine->tlb == NULL)
 		{
-			SwapPage(addr / PageSize, currentThread->space->tid);
+			SwapPage(addr / PageSize, currentThread->space);
+			Prefetch(addr / PageSize, currentThread->space);
 		}
 		else
 		{
 			int vpn = (unsigned)addr / PageSize,
 				idx = machine->find(vpn, currentThread->space->tid);
+			bool faulted = FALSE;
 
 			if (vpn >= machine->pageTableSize)
 			{
@@ -328,28 +786,22 @@ ExceptionHandler(ExceptionType which)
 			{
 				DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
 					addr, machine->pageTableSize);
-				idx = SwapPage(vpn, currentThread->space->tid);
+				idx = SwapPage(vpn, currentThread->space);
 				ASSERT(idx < NumPhysPages);
+				faulted = TRUE;
 			}
 
-			int pos = 0;
-			for(int i = 0; i < TLBSize; i++)
-			{
-				if(!machine->tlb[pos]) continue;
-				if(machine->tlb[i] == machine->InvPageTable+idx)
-				{
-					pos = i;
-					break;
-				}
-				if(!machine->tlb[i])
-					pos = i;
-				else if(machine->tlb[pos]->t > machine->tlb[i]->t)
-					pos = i;
-			}
-			machine->tlb[pos] = machine->InvPageTable+idx;
-			machine->tlb[pos]->t = stats->totalTicks;
+			FaultAround(vpn, currentThread->space);
+			LoadTLB(machine->InvPageTable+idx, FALSE);
+			machine->InvalidateTranslations();
+			if(faulted)	// may wait for the disk, so do it last
+				Prefetch(vpn, currentThread->space);
 		}
 	}
+	else if(which == ReadOnlyException
+		&& CopyOnWrite((unsigned)machine->ReadRegister(BadVAddrReg) / PageSize,
+			currentThread->space))
+		;	// the store is retried on the private copy
 	else {
 		printf("Unexpected user mode exception %d %d\n", which, type);
 		ASSERT(FALSE);
@@ -0,0 +1,237 @@
+// pageout.cc
+//	Routines for the pageout daemon.  See pageout.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "pageout.h"
+
+extern void EvictEntry(int pos);
+extern int SwapPage(unsigned int vpn, AddrSpace *space, bool prefetch);
+
+//----------------------------------------------------------------------
+// Pageout::Pageout
+// 	Start the pageout daemon.
+//
+//	"low" -- wake up when fewer frames than this are free; 0 means
+//		never: the daemon only reads ahead
+//	"high" -- go back to sleep once this many frames are free
+//----------------------------------------------------------------------
+
+Pageout::Pageout(int lo, int hi)
+{
+    low = lo;
+    high = hi;
+    running = FALSE;
+    cleanHand = 0;
+    wanted = new Semaphore("pageout wanted", 0);
+    aheadQueue = new List;
+    reading = NULL;
+    aheadLock = new Lock("read ahead");
+    aheadDone = new Condition("read ahead done");
+    if (low > 0)
+	ASSERT(low <= high && high < NumPhysPages);
+    Thread *t = new Thread("pageout");
+    t->Fork(Run, (void *) this);
+    DEBUG('a', "Pageout watermarks: low %d, high %d\n", low, high);
+}
+
+//----------------------------------------------------------------------
+// Pageout::~Pageout
+// 	De-allocate the daemon's bookkeeping.  Its thread is asleep,
+//	and Nachos is halting.
+//----------------------------------------------------------------------
+
+Pageout::~Pageout()
+{
+    delete wanted;
+    delete aheadQueue;
+    delete aheadLock;
+    delete aheadDone;
+}
+
+//----------------------------------------------------------------------
+// Pageout::Check
+// 	Called whenever a page fault has taken a free frame.  Wake the
+//	daemon if fewer than "low" frames are left, unless it is already
+//	at work.
+//----------------------------------------------------------------------
+
+void
+Pageout::Check()
+{
+    if (low > 0 && !running && memmap->NumClear() < low) {
+	running = TRUE;
+	wanted->V();
+    }
+}
+
+//----------------------------------------------------------------------
+// Pageout::Spare
+// 	Return TRUE if more than "low" frames are free, so that taking
+//	one will not wake the daemon.  Allocations that must never cause
+//	an eviction, like prefetching, only go ahead if there is a spare.
+//----------------------------------------------------------------------
+
+bool
+Pageout::Spare()
+{
+    return memmap->NumClear() > low;
+}
+
+//----------------------------------------------------------------------
+// Pageout::Run
+// 	The body of the daemon's thread: wait to be woken, then refill
+//	the pool of free frames and pre-clean if Check asked for it, and
+//	serve the read-ahead requests.
+//
+//	"self" -- the Pageout object
+//----------------------------------------------------------------------
+
+void
+Pageout::Run(int self)
+{
+    Pageout *daemon = (Pageout *) self;
+
+    for (;;) {
+	daemon->wanted->P();
+	if (daemon->running) {
+	    daemon->Refill();
+	    daemon->PreClean();
+	    daemon->running = FALSE;
+	}
+	daemon->ReadAheadQueued();
+    }
+}
+
+//----------------------------------------------------------------------
+// Pageout::Refill
+// 	Free frames until there are "high" of them: first the code pages
+//	that textCache keeps but no process maps, then the pages the
+//	replacement policy chooses.  Writing back a dirty page waits for
+//	the disk, but it is the daemon that waits, not a faulting thread.
+//----------------------------------------------------------------------
+
+void
+Pageout::Refill()
+{
+    int pn, victim;
+
+    while (memmap->NumClear() < high) {
+	if ((pn = textCache->Reclaim()) != -1) {
+	    memmap->Clear(pn);
+	    continue;
+	}
+	if ((victim = replacePolicy->Victim(machine->pageHash)) == -1)
+	    break;			// everything is pinned
+	stats->numPageouts++;
+	EvictEntry(victim);
+    }
+}
+
+//----------------------------------------------------------------------
+// Pageout::PreClean
+// 	Write back up to "high" dirty pages that have not been used for
+//	WorkingSetWindow ticks, and mark them clean, so that evicting them
+//	later costs nothing.  Idleness is judged from "t", which every
+//	reference refreshes whatever the policy; the use bit would not do,
+//	as only CLOCK and WSClock ever clear it.  Each frame is pinned
+//	while it is written; a store into the page in the meantime just
+//	makes it dirty again.
+//----------------------------------------------------------------------
+
+void
+Pageout::PreClean()
+{
+    TranslationEntry *entry = machine->InvPageTable;
+    int n = machine->pageHash->NumEntries();
+    int cleaned = 0;
+
+    for (int i = 0; i < n && cleaned < high; i++) {
+	TranslationEntry *e = &entry[cleanHand];
+	int pn = e->physicalPage;
+
+	cleanHand = (cleanHand + 1) % n;
+	if (!e->valid || !e->dirty || machine->pinCount[pn] > 0
+		|| stats->totalTicks - e->t <= WorkingSetWindow)
+	    continue;
+	e->dirty = FALSE;
+	machine->pinCount[pn]++;
+	swapArea->WritePage(e->tid, e->virtualPage,
+		machine->mainMemory + pn * PageSize);
+	machine->pinCount[pn]--;
+	stats->numPreCleans++;
+	cleaned++;
+    }
+}
+
+//----------------------------------------------------------------------
+// Pageout::ReadAhead
+// 	Ask the daemon to prefetch pages [first, first + count) of
+//	"space", and return at once.  A space has at most one request
+//	waiting; a newer one replaces it.
+//----------------------------------------------------------------------
+
+void
+Pageout::ReadAhead(AddrSpace *space, int first, int count)
+{
+    aheadLock->Acquire();
+    if (space->aheadCount == 0)
+	aheadQueue->Append((void *) space);
+    space->aheadFirst = first;
+    space->aheadCount = count;
+    aheadLock->Release();
+    wanted->V();
+}
+
+//----------------------------------------------------------------------
+// Pageout::Forget
+// 	"space" is being deallocated: drop its read-ahead request, and if
+//	the daemon is reading pages in for it right now, wait until it is
+//	done, so that no page is mapped for a space that is gone.
+//----------------------------------------------------------------------
+
+void
+Pageout::Forget(AddrSpace *space)
+{
+    aheadLock->Acquire();
+    if (space->aheadCount > 0) {
+	aheadQueue->Remove((void *) space);
+	space->aheadCount = 0;
+    }
+    while (reading == space)
+	aheadDone->Wait(aheadLock);
+    aheadLock->Release();
+}
+
+//----------------------------------------------------------------------
+// Pageout::ReadAheadQueued
+// 	Bring in the pages asked for by ReadAhead that are not resident
+//	yet, using free frames only (see SwapPage).  A request stops at
+//	the first page there is no spare frame for.
+//----------------------------------------------------------------------
+
+void
+Pageout::ReadAheadQueued()
+{
+    aheadLock->Acquire();
+    while (!aheadQueue->IsEmpty()) {
+	AddrSpace *space = (AddrSpace *) aheadQueue->Remove();
+	int first = space->aheadFirst, last = first + space->aheadCount;
+
+	space->aheadCount = 0;
+	reading = space;
+	aheadLock->Release();
+	for (int p = first; p < last && p < space->NumPages(); p++)
+	    if (machine->find(p, space->tid) >= (unsigned) NumPhysPages
+		    && SwapPage(p, space, TRUE) == -1)
+		break;
+	aheadLock->Acquire();
+	reading = NULL;
+	aheadDone->Broadcast(aheadLock);
+    }
+    aheadLock->Release();
+}
@@ -0,0 +1,64 @@
+// pageout.h
+//	Data structures for the pageout daemon, a kernel thread that
+//	keeps a pool of free frames, so that a page fault can usually
+//	just read its page in instead of first evicting (and writing back)
+//	another one.
+//
+//	The daemon sleeps until the number of free frames falls below a
+//	low watermark.  It then evicts the pages the replacement policy
+//	chooses until there are "high" free frames again, and writes back
+//	some dirty pages that have not been used lately, so that the next
+//	pages to go are clean.
+//
+//	The daemon also reads ahead for sequential page faults (see
+//	Prefetch in exception.cc), so that the faulting thread goes back
+//	to user mode after its own page is in, and the disk reads of the
+//	following pages overlap with its computing.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PAGEOUT_H
+#define PAGEOUT_H
+
+#include "copyright.h"
+#include "synch.h"
+
+class AddrSpace;
+
+class Pageout {
+  public:
+    Pageout(int low, int high);		// Start the daemon; low == 0
+					// means it never frees frames
+    ~Pageout();
+
+    void Check();			// A frame was taken: wake the
+					// daemon if free frames run low
+    bool Spare();			// Can a frame be taken without
+					// going below the low watermark?
+
+    void ReadAhead(AddrSpace *space, int first, int count);
+					// Ask for pages [first, first+count)
+					// of "space" to be prefetched
+    void Forget(AddrSpace *space);	// "space" is going away: drop its
+					// request, wait if it is being read
+
+  private:
+    static void Run(int self);		// The daemon's thread
+    void Refill();			// Free frames up to "high"
+    void PreClean();			// Write back idle dirty pages
+    void ReadAheadQueued();		// Serve the read-ahead requests
+
+    int low, high;			// watermarks, in free frames
+    Semaphore *wanted;			// V'd to wake the daemon
+    bool running;			// TRUE while it is refilling
+    int cleanHand;			// where PreClean looks next
+
+    List *aheadQueue;			// spaces with a read-ahead request
+    AddrSpace *reading;			// the space being read ahead for
+    Lock *aheadLock;			// protects the three above
+    Condition *aheadDone;		// signalled when "reading" changes
+};
+
+#endif // PAGEOUT_H
@@ -14,6 +14,8 @@
 #include "addrspace.h"
 #include "synch.h"
 
+#include <time.h>
+
 //----------------------------------------------------------------------
 // StartProcess
 // 	Run a user program.  Open the executable, load it into
@@ -30,11 +32,9 @@ StartProcess(char *filename)
 	printf("Unable to open file %s\n", filename);
 	return;
     }
-    space = new AddrSpace(executable);    
+    space = new AddrSpace(executable);	// the space closes the file
     currentThread->space = space;
 
-    delete executable;			// close file
-
     space->InitRegisters();		// set the initial register values
     space->RestoreState();		// load page table register
 
@@ -82,3 +82,85 @@ ConsoleTest (char *in, char *out)
 	if (ch == 'q') return;  // if q, quit
     }
 }
+
+//----------------------------------------------------------------------
+// PageTableBenchmark
+// 	Measure the host cost of inserting into and looking up the
+//	inverted page table, for tables of 32, 1K and 64K frames.  The
+//	table is filled with pages of several threads; half of the
+//	lookups hit and half miss.
+//
+//	Inserts are timed over a batch of tables holding 64K entries in
+//	all, so that even a 32-frame table takes long enough for clock()
+//	to measure; emptying the tables again is not timed.
+//----------------------------------------------------------------------
+
+static double
+Elapsed(clock_t start, int ops)
+{
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / ops;
+}
+
+void
+PageTableBenchmark()
+{
+    static int sizes[] = { 32, 1024, 65536 };
+    const int numThreads = 8;
+
+    for (int s = 0; s < 3; s++) {
+	int n = sizes[s];
+	int rounds = (1 << 22) / n;
+	int batch = 65536 / n;
+	HashedPageTable **tables = new HashedPageTable *[batch];
+	HashedPageTable *table;
+	clock_t start, inserting = 0;
+	int found = 0;
+
+	for (int b = 0; b < batch; b++)
+	    tables[b] = new HashedPageTable(n);
+	for (int r = 0; r < rounds; r += batch) {
+	    start = clock();
+	    for (int b = 0; b < batch; b++) {
+		table = tables[b];
+		for (int i = 0; i < n; i++) {
+		    int idx = table->Allocate();
+		    ASSERT(idx != -1);
+		    table->entries[idx].virtualPage = i / numThreads;
+		    table->entries[idx].tid = i % numThreads;
+		    table->Link(idx);
+		}
+	    }
+	    inserting += clock() - start;
+	    if (r + batch >= rounds)
+		break;			// leave them full for the lookups
+	    for (int b = 0; b < batch; b++)
+		for (int i = 0; i < n; i++) {
+		    tables[b]->Unlink(i);
+		    tables[b]->Free(i);
+		}
+	}
+	double insert = (double) inserting * 1e9 / CLOCKS_PER_SEC / (rounds * n);
+	table = tables[0];
+
+	start = clock();
+	for (int r = 0; r < rounds; r++)
+	    for (int i = 0; i < n; i++)
+		if (table->Lookup(i / numThreads, i % numThreads) != -1)
+		    found++;
+	double hit = Elapsed(start, rounds * n);
+
+	start = clock();
+	for (int r = 0; r < rounds; r++)
+	    for (int i = 0; i < n; i++)
+		if (table->Lookup(i / numThreads + n, i % numThreads) != -1)
+		    found++;
+	double miss = Elapsed(start, rounds * n);
+
+	ASSERT(found == rounds * n);
+	printf("%6d frames: insert %.1f ns, hit %.1f ns, miss %.1f ns\n",
+	       n, insert, hit, miss);
+	for (int b = 0; b < batch; b++)
+	    delete tables[b];
+	delete [] tables;
+    }
+}
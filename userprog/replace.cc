@@ -0,0 +1,125 @@
+// replace.cc 
+//	Page replacement policies for SwapPage.  See replace.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "replace.h"
+
+//----------------------------------------------------------------------
+// Replaceable
+// 	Return TRUE if the frame of "entry" may be taken: it holds a page
+//	and no kernel I/O is in progress on it.
+//----------------------------------------------------------------------
+
+static bool
+Replaceable(TranslationEntry *entry)
+{
+    return entry->valid && machine->pinCount[entry->physicalPage] == 0;
+}
+
+//----------------------------------------------------------------------
+// LRUPolicy::Victim
+// 	Return the replaceable entry least recently used.
+//----------------------------------------------------------------------
+
+int
+LRUPolicy::Victim(HashedPageTable *table)
+{
+    TranslationEntry *entry = table->entries;
+    int victim = -1;
+
+    for (int i = 0; i < table->NumEntries(); i++)
+	if (Replaceable(&entry[i])
+		&& (victim == -1 || entry[i].t < entry[victim].t))
+	    victim = i;
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// ClockPolicy::Victim
+// 	Advance the hand to the first replaceable entry whose use bit is
+//	clear, clearing the use bits it passes.  Two turns are enough: the
+//	first clears every use bit.
+//----------------------------------------------------------------------
+
+int
+ClockPolicy::Victim(HashedPageTable *table)
+{
+    TranslationEntry *entry = table->entries;
+    int n = table->NumEntries();
+
+    for (int i = 0; i < 2 * n; i++) {
+	int at = hand;
+
+	hand = (hand + 1) % n;
+	if (!Replaceable(&entry[at]))
+	    continue;
+	if (entry[at].use) {
+	    entry[at].use = FALSE;	// give it a second chance
+	    continue;
+	}
+	return at;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// WSClockPolicy::Victim
+// 	Like ClockPolicy::Victim, but a page used since the hand last
+//	passed has its time of last use brought up to date, and a page
+//	is only taken once it has gone unused for "window" ticks.  Clean
+//	pages are taken first; after two turns, settle for the first old
+//	dirty page, and failing that, for the least recently used page.
+//----------------------------------------------------------------------
+
+int
+WSClockPolicy::Victim(HashedPageTable *table)
+{
+    TranslationEntry *entry = table->entries;
+    int n = table->NumEntries();
+    int oldDirty = -1, lru = -1;
+
+    for (int i = 0; i < 2 * n; i++) {
+	int at = hand;
+
+	hand = (hand + 1) % n;
+	if (!Replaceable(&entry[at]))
+	    continue;
+	if (entry[at].use) {
+	    entry[at].use = FALSE;
+	    entry[at].t = stats->totalTicks;
+	    continue;
+	}
+	if (lru == -1 || entry[at].t < entry[lru].t)
+	    lru = at;
+	if (stats->totalTicks - entry[at].t <= window)
+	    continue;			// still in the working set
+	if (!entry[at].dirty)
+	    return at;
+	if (oldDirty == -1)
+	    oldDirty = at;
+    }
+    return (oldDirty != -1) ? oldDirty : lru;
+}
+
+//----------------------------------------------------------------------
+// NewReplacePolicy
+// 	Create the replacement policy called "name" ("lru", "clock" or
+//	"wsclock"); return NULL if there is no such policy.
+//----------------------------------------------------------------------
+
+ReplacePolicy *
+NewReplacePolicy(char *name)
+{
+    if (!strcmp(name, "lru"))
+	return new LRUPolicy;
+    if (!strcmp(name, "clock"))
+	return new ClockPolicy;
+    if (!strcmp(name, "wsclock"))
+	return new WSClockPolicy(WorkingSetWindow);
+    return NULL;
+}
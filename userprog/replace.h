@@ -0,0 +1,75 @@
+// replace.h 
+//	Data structures for choosing which page to give up when a page
+//	fault finds every frame of physical memory in use.
+//
+//	Entries of the inverted page table correspond one to one with
+//	frames, so a policy works on entry indices.  It decides from the
+//	use and dirty bits that Translate sets, and from "t", the time
+//	the page was last referenced through the TLB or brought in.
+//	Frames pinned by kernel I/O are never chosen.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef REPLACE_H
+#define REPLACE_H
+
+#include "copyright.h"
+#include "translate.h"
+
+#define WorkingSetWindow	2000	// WSClock: ticks since its last use
+					// after which a page may be taken
+
+// The interface every replacement policy provides.
+
+class ReplacePolicy {
+  public:
+    virtual ~ReplacePolicy() {}
+
+    virtual int Victim(HashedPageTable *table) = 0;
+				// Index of the valid entry whose frame
+				// should be reused, or -1 if all are pinned
+    virtual const char *Name() const = 0;
+};
+
+// Exact LRU: the page with the oldest time of last use.  Needs a full
+// scan of the table on every replacement.
+
+class LRUPolicy : public ReplacePolicy {
+  public:
+    int Victim(HashedPageTable *table);
+    const char *Name() const { return "lru"; }
+};
+
+// CLOCK (second chance): a hand sweeps the frames, clearing use bits,
+// and stops at the first frame not used since the hand last passed.
+
+class ClockPolicy : public ReplacePolicy {
+  public:
+    ClockPolicy() { hand = 0; }
+    int Victim(HashedPageTable *table);
+    const char *Name() const { return "clock"; }
+
+  private:
+    int hand;			// next entry to look at
+};
+
+// WSClock: CLOCK restricted to pages outside the working set (unused
+// for more than "window" ticks), preferring clean pages so that a
+// replacement does not have to wait for a write back.
+
+class WSClockPolicy : public ReplacePolicy {
+  public:
+    WSClockPolicy(int w) { hand = 0; window = w; }
+    int Victim(HashedPageTable *table);
+    const char *Name() const { return "wsclock"; }
+
+  private:
+    int hand;
+    int window;
+};
+
+extern ReplacePolicy *NewReplacePolicy(char *name);
+				// The policy called "name", or NULL
+#endif // REPLACE_H
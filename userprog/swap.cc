@@ -0,0 +1,159 @@
+// swap.cc 
+//	Routines to keep the pages of user programs in the swap area.
+//	See swap.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "swap.h"
+
+//----------------------------------------------------------------------
+// SwapArea::SwapArea
+// 	Set up an empty swap area.
+//
+//	"disk" -- the disk the area is on
+//	"firstSector", "numSectors" -- the sectors of the area; the file
+//		system must never allocate them
+//----------------------------------------------------------------------
+
+SwapArea::SwapArea(SynchDisk *d, int first, int numSectors)
+{
+    disk = d;
+    firstSector = first;
+    sectorsPerSlot = PageSize / SectorSize;
+    slots = new BitMap(numSectors / sectorsPerSlot);
+    slotRefs = new int[numSectors / sectorsPerSlot];
+    for (int i = 0; i < MaxThreadNum; i++) {
+	slotMap[i] = NULL;
+	numPages[i] = 0;
+    }
+}
+
+//----------------------------------------------------------------------
+// SwapArea::~SwapArea
+// 	De-allocate the swap area bookkeeping.
+//----------------------------------------------------------------------
+
+SwapArea::~SwapArea()
+{
+    for (int i = 0; i < MaxThreadNum; i++)
+	delete [] slotMap[i];
+    delete slots;
+    delete [] slotRefs;
+}
+
+//----------------------------------------------------------------------
+// SwapArea::AddSpace
+// 	Start an empty slot map for the address space named "tid".
+//
+//	"numPages" -- the size of the address space
+//----------------------------------------------------------------------
+
+void
+SwapArea::AddSpace(int tid, int n)
+{
+    ASSERT(slotMap[tid] == NULL);
+    slotMap[tid] = new int[n];
+    numPages[tid] = n;
+    for (int i = 0; i < n; i++)
+	slotMap[tid][i] = -1;
+}
+
+//----------------------------------------------------------------------
+// SwapArea::ForkSpace
+// 	Start the slot map of the address space "child", forked from
+//	"parent", as a copy of the parent's: the pages the parent has
+//	written out are where the child will find them too.
+//----------------------------------------------------------------------
+
+void
+SwapArea::ForkSpace(int parent, int child)
+{
+    AddSpace(child, numPages[parent]);
+    for (int i = 0; i < numPages[parent]; i++) {
+	slotMap[child][i] = slotMap[parent][i];
+	if (slotMap[child][i] != -1)
+	    slotRefs[slotMap[child][i]]++;
+    }
+}
+
+//----------------------------------------------------------------------
+// SwapArea::RemoveSpace
+// 	Return the slots of the address space named "tid" to the free
+//	pool, unless a forked space still shares them.
+//----------------------------------------------------------------------
+
+void
+SwapArea::RemoveSpace(int tid)
+{
+    for (int i = 0; i < numPages[tid]; i++)
+	if (slotMap[tid][i] != -1 && --slotRefs[slotMap[tid][i]] == 0)
+	    slots->Clear(slotMap[tid][i]);
+    delete [] slotMap[tid];
+    slotMap[tid] = NULL;
+    numPages[tid] = 0;
+}
+
+//----------------------------------------------------------------------
+// SwapArea::SlotSector
+// 	Return the first disk sector of the slot holding page "vpn" of
+//	the address space named "tid".
+//----------------------------------------------------------------------
+
+int
+SwapArea::SlotSector(int tid, int vpn)
+{
+    ASSERT(slotMap[tid] != NULL && vpn >= 0 && vpn < numPages[tid]);
+    return firstSector + slotMap[tid][vpn] * sectorsPerSlot;
+}
+
+//----------------------------------------------------------------------
+// SwapArea::ReadPage
+// 	Read page "vpn" of the address space named "tid" from its slot.
+//
+//	"into" -- where to put the page, PageSize bytes
+//----------------------------------------------------------------------
+
+void
+SwapArea::ReadPage(int tid, int vpn, char *into)
+{
+    int sector = SlotSector(tid, vpn);
+
+    for (int i = 0; i < sectorsPerSlot; i++)
+	disk->ReadSector(sector + i, into + i * SectorSize);
+}
+
+//----------------------------------------------------------------------
+// SwapArea::WritePage
+// 	Write page "vpn" of the address space named "tid" to its slot,
+//	first finding it a free slot if it has none, or if it shares its
+//	slot with a forked space.
+//
+//	"from" -- the contents of the page, PageSize bytes
+//----------------------------------------------------------------------
+
+void
+SwapArea::WritePage(int tid, int vpn, char *from)
+{
+    ASSERT(slotMap[tid] != NULL && vpn >= 0 && vpn < numPages[tid]);
+    if (slotMap[tid][vpn] != -1 && slotRefs[slotMap[tid][vpn]] > 1) {
+	slotRefs[slotMap[tid][vpn]]--;	// leave the shared copy alone
+	slotMap[tid][vpn] = -1;
+    }
+    if (slotMap[tid][vpn] == -1) {
+	slotMap[tid][vpn] = slots->Find();
+	if (slotMap[tid][vpn] == -1)
+	    throw std::overflow_error("running out of swap space");
+	slotRefs[slotMap[tid][vpn]] = 1;
+	DEBUG('a', "Swap: slot %d for page %d of space %d\n",
+	      slotMap[tid][vpn], vpn, tid);
+    }
+
+    int sector = SlotSector(tid, vpn);
+
+    for (int i = 0; i < sectorsPerSlot; i++)
+	disk->WriteSector(sector + i, from + i * SectorSize);
+}
@@ -0,0 +1,69 @@
+// swap.h 
+//	Data structures for the swap area: a run of contiguous sectors,
+//	the data of the file /.swap (see FileSystem::ReserveSwap), where
+//	the pages of user programs are kept while they are not in memory.
+//
+//	The area is divided into slots, each holding one page (a page is
+//	a whole number of sectors), and pages move between a slot and
+//	mainMemory with plain sector reads and writes -- no file to open,
+//	no directory or file header to look at.
+//
+//	Every address space has a slot map giving the slot of each of its
+//	virtual pages.  A page only gets a slot the first time it is
+//	written out; until then it has none, and its contents come from
+//	elsewhere (see AddrSpace::LoadPage).  As in the page table, an
+//	address space is named by its "tid".
+//
+//	A forked address space starts out sharing its parent's slots; a
+//	slot is reference counted, and a space writing a page whose slot
+//	is shared gets a new slot for it first.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SWAP_H
+#define SWAP_H
+
+#include "copyright.h"
+#include "bitmap.h"
+#include "synchdisk.h"
+
+class SwapArea {
+  public:
+    SwapArea(SynchDisk *disk, int firstSector, int numSectors);
+					// Manage sectors [firstSector,
+					// firstSector + numSectors) of "disk"
+    ~SwapArea();
+
+    void AddSpace(int tid, int numPages);
+					// Start a slot map for a new address
+					// space, with no slots in it
+    void ForkSpace(int parent, int child);
+					// Start the slot map of a forked
+					// space, sharing the parent's slots
+    void RemoveSpace(int tid);		// Reclaim the slots of a space
+
+    bool HasSlot(int tid, int vpn)	// Has the page been written out?
+	{ return slotMap[tid][vpn] != -1; }
+    void ReadPage(int tid, int vpn, char *into);
+    void WritePage(int tid, int vpn, char *from);
+					// Move one page between its slot and
+					// memory, giving the page a slot
+					// if it has none
+
+    int NumFreeSlots() { return slots->NumClear(); }
+
+  private:
+    int SlotSector(int tid, int vpn);	// first sector of the page's slot
+
+    SynchDisk *disk;
+    int firstSector;
+    int sectorsPerSlot;
+    BitMap *slots;			// which slots are in use
+    int *slotRefs;			// slot maps pointing at each slot
+    int *slotMap[MaxThreadNum];		// slot of each page, per space
+    int numPages[MaxThreadNum];		// size of each slot map
+};
+
+#endif // SWAP_H
@@ -31,6 +31,7 @@
 #define SC_Yield	10
 #define SC_PutChar	11
 #define SC_PutInt	12
+#define SC_ProcFork	13
 
 #ifndef IN_ASM
 
@@ -126,6 +127,13 @@ void Fork(void (*func)());
  */
 void Yield();		
 
+/* Create a new process running a copy of the current address space,
+ * like UNIX fork.  The copy is made lazily: pages are shared until one
+ * of the processes writes to them.  Returns the SpaceId of the child
+ * (which can be given to Join) to the parent, and 0 to the child.
+ */
+SpaceId ProcFork();
+
 void PutChar(char ch);
 void PutInt(int num);
 
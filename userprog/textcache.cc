@@ -0,0 +1,152 @@
+// textcache.cc 
+//	Routines to share code pages among processes running the same
+//	executable.  See textcache.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "textcache.h"
+
+//----------------------------------------------------------------------
+// TextCache::TextCache
+// 	Initialize a cache that can hold every frame of physical memory.
+//----------------------------------------------------------------------
+
+TextCache::TextCache(int n)
+{
+    numFrames = n;
+    table = new HashedPageTable(n);
+    entryOf = new int[n];
+    for (int i = 0; i < n; i++)
+	entryOf[i] = -1;
+    hand = 0;
+}
+
+//----------------------------------------------------------------------
+// TextCache::~TextCache
+//----------------------------------------------------------------------
+
+TextCache::~TextCache()
+{
+    delete table;
+    delete [] entryOf;
+}
+
+//----------------------------------------------------------------------
+// TextCache::Lookup
+// 	Return the frame holding code page "vpn" of the executable whose
+//	file header is at "fileSector", or -1 if it is not in memory.
+//----------------------------------------------------------------------
+
+int
+TextCache::Lookup(int fileSector, int vpn)
+{
+    int idx = table->Lookup(vpn, fileSector);
+
+    return (idx == -1) ? -1 : table->entries[idx].physicalPage;
+}
+
+//----------------------------------------------------------------------
+// TextCache::Insert
+// 	Remember that "frame" holds code page "vpn" of the executable
+//	whose file header is at "fileSector".  The page must not be
+//	cached already.
+//----------------------------------------------------------------------
+
+void
+TextCache::Insert(int fileSector, int vpn, int frame)
+{
+    int idx = table->Allocate();
+
+    ASSERT(idx != -1 && entryOf[frame] == -1);
+    table->entries[idx].virtualPage = vpn;
+    table->entries[idx].tid = fileSector;
+    table->entries[idx].physicalPage = frame;
+    table->entries[idx].valid = TRUE;
+    table->Link(idx);
+    entryOf[frame] = idx;
+    filePages[fileSector]++;
+}
+
+//----------------------------------------------------------------------
+// TextCache::Remove
+// 	Forget what "frame" holds.
+//----------------------------------------------------------------------
+
+void
+TextCache::Remove(int frame)
+{
+    int idx = entryOf[frame];
+    int fileSector = table->entries[idx].tid;
+
+    table->Unlink(idx);
+    table->Free(idx);
+    entryOf[frame] = -1;
+    if (--filePages[fileSector] == 0)
+	filePages.erase(fileSector);
+}
+
+//----------------------------------------------------------------------
+// TextCache::Keep
+// 	Called when no page table entry maps "frame" any more.  Return
+//	TRUE if the frame holds a code page, which stays cached (and the
+//	frame allocated) until Reclaim gives it up; FALSE if the caller
+//	should free the frame.
+//----------------------------------------------------------------------
+
+bool
+TextCache::Keep(int frame)
+{
+    return entryOf[frame] != -1;
+}
+
+//----------------------------------------------------------------------
+// TextCache::Reclaim
+// 	Find a cached frame that no process maps and is not pinned, drop
+//	it from the cache and return it, still marked in use in memmap.
+//	Return -1 if every cached frame is in use.
+//----------------------------------------------------------------------
+
+int
+TextCache::Reclaim()
+{
+    if (filePages.empty())
+	return -1;
+    for (int i = 0; i < numFrames; i++) {
+	int frame = hand;
+
+	hand = (hand + 1) % numFrames;
+	if (entryOf[frame] != -1 && machine->frameRefs[frame] == 0
+		&& machine->pinCount[frame] == 0) {
+	    Remove(frame);
+	    return frame;
+	}
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// TextCache::ForgetFile
+// 	Drop the cached pages of the executable whose file header is at
+//	"fileSector", because the file is being written or removed.
+//	Idle frames are freed; frames still mapped stay with the processes
+//	using them, and are freed when those let go.
+//----------------------------------------------------------------------
+
+void
+TextCache::ForgetFile(int fileSector)
+{
+    if (filePages.find(fileSector) == filePages.end())
+	return;
+    for (int frame = 0; frame < numFrames; frame++) {
+	if (entryOf[frame] == -1
+		|| table->entries[entryOf[frame]].tid != fileSector)
+	    continue;
+	Remove(frame);
+	if (machine->frameRefs[frame] == 0)
+	    memmap->Clear(frame);
+    }
+}
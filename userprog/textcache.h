@@ -0,0 +1,56 @@
+// textcache.h 
+//	Data structures for sharing the code pages of a program among all
+//	the processes running it.
+//
+//	A page that lies wholly inside the code segment of an executable
+//	never changes, so one frame can hold it for every process running
+//	that executable: each maps the frame read-only through its own
+//	entry of the inverted page table.  The cache finds the frame from
+//	the executable -- named by the sector of its file header -- and
+//	the page number.
+//
+//	When the last process unmaps a code frame, the cache holds on to
+//	it, so that a program run again soon (say, from the shell) finds
+//	its code still in memory.  Such idle frames are the first to be
+//	reused when memory runs out.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TEXTCACHE_H
+#define TEXTCACHE_H
+
+#include "copyright.h"
+#include "translate.h"
+#include <map>
+
+class TextCache {
+  public:
+    TextCache(int numFrames);		// Initialize an empty cache
+    ~TextCache();
+
+    int Lookup(int fileSector, int vpn);
+					// Frame holding page "vpn" of the
+					// executable, or -1
+    void Insert(int fileSector, int vpn, int frame);
+					// Remember that "frame" holds it
+    bool Keep(int frame);		// The last mapping of "frame" is
+					// gone; TRUE if the cache keeps it
+    int Reclaim();			// Take back an idle frame for other
+					// use; -1 if there is none
+    void ForgetFile(int fileSector);	// The file changed or went away:
+					// drop its pages
+
+  private:
+    void Remove(int frame);		// Drop "frame" from the cache
+
+    HashedPageTable *table;		// keyed by <file sector, page>
+    int *entryOf;			// per frame, its entry in "table"
+					// or -1 if the frame is not cached
+    std::map<int, int> filePages;	// cached pages of each executable
+    int numFrames;
+    int hand;				// where Reclaim looks next
+};
+
+#endif // TEXTCACHE_H